@@ -1,43 +1,251 @@
 #include "VmaHost.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+namespace vkutils{const char* vk_result_str(VkResult);}
 
 VmaAllocator VmaHost::_getAllocator(const VulkanDeviceHandlePair& aDevicePair){
-    base_map_t::const_iterator finder = this->find(aDevicePair);
-    if(finder == this->end()){
-        VmaAllocator allocator = _createNewAllocator(aDevicePair);
-        this->insert({aDevicePair, allocator});
+    VmaAllocator allocator = _findAllocator(aDevicePair);
+    if(allocator != nullptr) return(allocator);
+
+    // Another thread may have created the allocator while this one waited on the lock
+    std::lock_guard<std::mutex> lock(_mWriteMutex);
+    allocator = _findAllocator(aDevicePair);
+    if(allocator != nullptr) return(allocator);
+
+    for(_AllocatorSlot& slot : _mSlots){
+        if(slot.device.load(std::memory_order_relaxed) != VK_NULL_HANDLE) continue;
+
+        VmaAllocatorConfig config = _negotiateConfig(aDevicePair);
+        allocator = _createNewAllocator(aDevicePair, config);
+
+        slot.beginWrite();
+        slot.config = config;
+        slot.physicalDevice.store(aDevicePair.physicalDevice, std::memory_order_relaxed);
+        slot.allocator.store(allocator, std::memory_order_relaxed);
+        slot.device.store(aDevicePair.device, std::memory_order_relaxed);
+        slot.endWrite();
         return(allocator);
-    }else{
-        return(finder->second);
     }
+    throw std::runtime_error("VmaHost has no free allocator slots! (raise VMA_HOST_MAX_DEVICES)");
+}
+
+VmaAllocator VmaHost::_findAllocator(const VulkanDeviceHandlePair& aDevicePair) const{
+    for(const _AllocatorSlot& slot : _mSlots){
+        while(true){
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            VkDevice device = slot.device.load(std::memory_order_relaxed);
+            VkPhysicalDevice physicalDevice = slot.physicalDevice.load(std::memory_order_relaxed);
+            VmaAllocator allocator = slot.allocator.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            // A writer got in between, read the slot again
+            if((sequence & 1) != 0 || slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+            if(device == aDevicePair.device && physicalDevice == aDevicePair.physicalDevice) return(allocator);
+            break;
+        }
+    }
+    return(nullptr);
+}
+
+bool VmaHost::_destroyAllocator(const VulkanDeviceHandlePair& aDevicePair){
+    std::lock_guard<std::mutex> lock(_mWriteMutex);
+    for(_AllocatorSlot& slot : _mSlots){
+        if(slot.device.load(std::memory_order_relaxed) != aDevicePair.device) continue;
+        if(slot.physicalDevice.load(std::memory_order_relaxed) != aDevicePair.physicalDevice) continue;
+
+        // Owners of a pool still holding allocations would free them through a destroyed allocator later
+        VmaAllocator allocator = slot.allocator.load(std::memory_order_relaxed);
+        for(const std::pair<const std::string, VmaPool>& pool : slot.pools){
+            VmaStatistics stats = {};
+            vmaGetPoolStatistics(allocator, pool.second, &stats);
+            if(stats.allocationCount == 0) continue;
+            std::cerr << "Warning: Not destroying the VMA allocator, pool " << pool.first << " still has " << stats.allocationCount << " allocations" << std::endl;
+            return(false);
+        }
+
+        // Unpublish the slot before the allocator goes away so new lookups miss it
+        for(const std::pair<const std::string, VmaPool>& pool : slot.pools) vmaDestroyPool(allocator, pool.second);
+        slot.pools.clear();
+        slot.beginWrite();
+        slot.config = VmaAllocatorConfig();
+        slot.device.store(VK_NULL_HANDLE, std::memory_order_relaxed);
+        slot.allocator.store(nullptr, std::memory_order_relaxed);
+        slot.physicalDevice.store(VK_NULL_HANDLE, std::memory_order_relaxed);
+        slot.endWrite();
+        vmaDestroyAllocator(allocator);
+        return(true);
+    }
+    return(true);
+}
+
+VmaHost::_AllocatorSlot* VmaHost::_findSlotLocked(const VulkanDeviceHandlePair& aDevicePair){
+    for(_AllocatorSlot& slot : _mSlots){
+        if(slot.device.load(std::memory_order_relaxed) != aDevicePair.device) continue;
+        if(slot.physicalDevice.load(std::memory_order_relaxed) != aDevicePair.physicalDevice) continue;
+        return(&slot);
+    }
+    return(nullptr);
+}
+
+VmaPool VmaHost::_createPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName, const VmaPoolCreateInfo& aCreateInfo){
+    VmaAllocator allocator = _getAllocator(aDevicePair);
+
+    std::lock_guard<std::mutex> lock(_mWriteMutex);
+    _AllocatorSlot* slot = _findSlotLocked(aDevicePair);
+    if(slot == nullptr) throw std::runtime_error("Allocator was destroyed while creating pool " + aName + "!");
+    if(slot->pools.count(aName) != 0) throw std::runtime_error("VMA pool " + aName + " already exists for this device!");
+
+    VmaPool pool = VK_NULL_HANDLE;
+    VkResult createResult = vmaCreatePool(allocator, &aCreateInfo, &pool);
+    if(createResult != VK_SUCCESS){
+        throw std::runtime_error("Failed to create VMA pool " + aName + "! (" + std::string(vkutils::vk_result_str(createResult)) + ")");
+    }
+    vmaSetPoolName(allocator, pool, aName.c_str());
+    slot->pools.emplace(aName, pool);
+    return(pool);
+}
+
+VmaPool VmaHost::_getPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName){
+    std::lock_guard<std::mutex> lock(_mWriteMutex);
+    _AllocatorSlot* slot = _findSlotLocked(aDevicePair);
+    if(slot == nullptr) return(VK_NULL_HANDLE);
+    std::unordered_map<std::string, VmaPool>::const_iterator finder = slot->pools.find(aName);
+    return(finder == slot->pools.end() ? VK_NULL_HANDLE : finder->second);
+}
+
+void VmaHost::_destroyPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName){
+    std::lock_guard<std::mutex> lock(_mWriteMutex);
+    _AllocatorSlot* slot = _findSlotLocked(aDevicePair);
+    if(slot == nullptr) return;
+    std::unordered_map<std::string, VmaPool>::iterator finder = slot->pools.find(aName);
+    if(finder == slot->pools.end()) return;
+    vmaDestroyPool(slot->allocator.load(std::memory_order_relaxed), finder->second);
+    slot->pools.erase(finder);
 }
 
-void VmaHost::_destroyAllocator(const VulkanDeviceHandlePair& aDevicePair){
-    base_map_t::const_iterator finder = this->find(aDevicePair);
-    if(finder != this->end()){
-        vmaDestroyAllocator(finder->second);
-        this->erase(finder);
+void VmaHost::_destroyPool(const VulkanDeviceHandlePair& aDevicePair, VmaPool aPool){
+    std::lock_guard<std::mutex> lock(_mWriteMutex);
+    _AllocatorSlot* slot = _findSlotLocked(aDevicePair);
+    if(slot == nullptr) return;
+    for(std::unordered_map<std::string, VmaPool>::iterator iter = slot->pools.begin(); iter != slot->pools.end(); ++iter){
+        if(iter->second != aPool) continue;
+        vmaDestroyPool(slot->allocator.load(std::memory_order_relaxed), aPool);
+        slot->pools.erase(iter);
+        return;
     }
 }
 
 bool VmaHost::_allocatorExists(const VulkanDeviceHandlePair& aDevicePair){
-    base_map_t::const_iterator finder = this->find(aDevicePair);
-    return(finder != this->end());
+    return(_findAllocator(aDevicePair) != nullptr);
+}
+
+VmaAllocatorConfig VmaHost::_getAllocatorConfig(const VulkanDeviceHandlePair& aDevicePair){
+    _getAllocator(aDevicePair);
+
+    std::lock_guard<std::mutex> lock(_mWriteMutex);
+    _AllocatorSlot* slot = _findSlotLocked(aDevicePair);
+    return(slot == nullptr ? VmaAllocatorConfig() : slot->config);
+}
+
+// Newest Vulkan version the VMA implementation was compiled against
+static uint32_t vma_supported_api_version(){
+    #if defined(VMA_VULKAN_VERSION) && VMA_VULKAN_VERSION >= 1003000
+    return(VK_API_VERSION_1_3);
+    #elif defined(VMA_VULKAN_VERSION) && VMA_VULKAN_VERSION >= 1002000
+    return(VK_API_VERSION_1_2);
+    #elif defined(VMA_VULKAN_VERSION) && VMA_VULKAN_VERSION >= 1001000
+    return(VK_API_VERSION_1_1);
+    #else
+    return(VK_API_VERSION_1_0);
+    #endif
+}
+
+VmaAllocatorConfig VmaHost::_negotiateConfig(const VulkanDeviceHandlePair& aDevicePair) const{
+    const VulkanPhysicalDevice physicalDevice = VulkanPhysicalDevice::getSnapshot(
+        aDevicePair.physicalDevice,
+        _mInstance.load(std::memory_order_acquire),
+        _mInstanceApiVersion.load(std::memory_order_relaxed)
+    );
+    const PropertyNameIndex extensions = VulkanLogicalDevice::findEnabledExtensions(aDevicePair.device);
+    const VulkanFeatureChain features = VulkanLogicalDevice::findEnabledFeatures(aDevicePair.device);
+
+    // VMA compares whole versions, so drop the patch level
+    uint32_t apiVersion = std::min({
+        _mInstanceApiVersion.load(std::memory_order_relaxed),
+        physicalDevice.mApiVersion,
+        vma_supported_api_version()
+    });
+
+    VmaAllocatorConfig config;
+    config.vulkanApiVersion = VK_MAKE_API_VERSION(0, VK_API_VERSION_MAJOR(apiVersion), VK_API_VERSION_MINOR(apiVersion), 0);
+
+    if(config.vulkanApiVersion < VK_API_VERSION_1_1){
+        if(extensions.contains("VK_KHR_get_memory_requirements2") && extensions.contains("VK_KHR_dedicated_allocation")){
+            config.flags |= VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT;
+        }
+        if(extensions.contains("VK_KHR_bind_memory2")){
+            config.flags |= VMA_ALLOCATOR_CREATE_KHR_BIND_MEMORY2_BIT;
+        }
+    }
+
+    // Real heap budgets instead of VMA's estimate. The extension relies on vkGetPhysicalDeviceMemoryProperties2, core from 1.1.
+    if(config.vulkanApiVersion >= VK_API_VERSION_1_1 && extensions.contains("VK_EXT_memory_budget")){
+        config.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+
+    // The feature is only set when it was enabled through the 1.2 struct or VK_KHR_buffer_device_address.
+    // Below 1.2 VMA loads the KHR entry points, so the extension must be enabled too.
+    if(features.vulkan12().bufferDeviceAddress && (config.vulkanApiVersion >= VK_API_VERSION_1_2 || extensions.contains("VK_KHR_buffer_device_address"))){
+        config.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    }
+
+    // Lets allocations carry VkMemoryPriorityAllocateInfoEXT, which VMA only adds once told both are enabled
+    if(features.memoryPriority() && extensions.contains("VK_EXT_memory_priority")){
+        config.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_PRIORITY_BIT;
+    }
+
+    if(config.vulkanApiVersion >= VK_API_VERSION_1_3 && features.vulkan13().maintenance4){
+        config.flags |= VMA_ALLOCATOR_CREATE_KHR_MAINTENANCE4_BIT;
+    }
+    return(config);
 }
 
-VmaAllocator VmaHost::_createNewAllocator(const VulkanDeviceHandlePair& aDevicePair){
+VmaAllocator VmaHost::_createNewAllocator(const VulkanDeviceHandlePair& aDevicePair, const VmaAllocatorConfig& aConfig){
     VmaAllocatorCreateInfo createInfo = {};
     {
-		createInfo.instance = _mInstance;
+		createInfo.instance = _mInstance.load(std::memory_order_acquire);
         createInfo.device = aDevicePair.device;
         createInfo.physicalDevice = aDevicePair.physicalDevice;
-        #ifdef VULKAN_BASE_VK_API_VERSION
-        createInfo.vulkanApiVersion = VULKAN_BASE_VK_API_VERSION;
-        #else
-        createInfo.vulkanApiVersion = VK_API_VERSION_1_0;
-        #endif
+        createInfo.vulkanApiVersion = aConfig.vulkanApiVersion;
+        createInfo.flags = aConfig.flags;
     }
 
     VmaAllocator allocator = nullptr;
-    vmaCreateAllocator(&createInfo, &allocator);
+    VkResult createResult = vmaCreateAllocator(&createInfo, &allocator);
+    if(createResult != VK_SUCCESS){
+        throw std::runtime_error("Failed to create VMA allocator! (" + std::string(vkutils::vk_result_str(createResult)) + ")");
+    }
     return(allocator);
-}
\ No newline at end of file
+}
+
+std::string VmaAllocatorConfig::describe() const{
+    std::vector<std::string> paths;
+    if(usesDedicatedAllocation()) paths.push_back("dedicated allocation");
+    if(usesBindMemory2()) paths.push_back("bind memory 2");
+    if(hasFlag(VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT)) paths.push_back("memory budget");
+    if(hasFlag(VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT)) paths.push_back("buffer device address");
+    if(hasFlag(VMA_ALLOCATOR_CREATE_EXT_MEMORY_PRIORITY_BIT)) paths.push_back("memory priority");
+    if(hasFlag(VMA_ALLOCATOR_CREATE_KHR_MAINTENANCE4_BIT)) paths.push_back("maintenance4");
+
+    std::string description = "Vulkan " + std::to_string(VK_API_VERSION_MAJOR(vulkanApiVersion)) + "." + std::to_string(VK_API_VERSION_MINOR(vulkanApiVersion)) + ":";
+    for(size_t i = 0; i < paths.size(); ++i){
+        description += (i == 0 ? " " : ", ") + paths[i];
+    }
+    if(paths.empty()) description += " no optional paths";
+    return(description);
+}
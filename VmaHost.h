@@ -4,6 +4,37 @@
 #include <vk_mem_alloc.h>
 #include "VulkanDevices.h"
 #include <functional> 
+#include <atomic>
+#include <mutex>
+#include <array>
+#include <string>
+
+// Maximum number of devices VmaHost can hold allocators for at once
+#ifndef VMA_HOST_MAX_DEVICES
+#define VMA_HOST_MAX_DEVICES 16
+#endif
+
+// Vulkan version of the VkInstance given to VmaHost::setVkInstance() when the caller doesn't pass one
+#ifndef VMA_HOST_DEFAULT_INSTANCE_API_VERSION
+#define VMA_HOST_DEFAULT_INSTANCE_API_VERSION VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+#endif
+
+/// API version and flags VmaHost negotiated for one device's allocator
+struct VmaAllocatorConfig
+{
+    /// Lowest of the instance's version, the device's version and the newest version VMA was built for
+    uint32_t vulkanApiVersion = VK_API_VERSION_1_0;
+    VmaAllocatorCreateFlags flags = 0;
+
+    bool hasFlag(VmaAllocatorCreateFlagBits aFlag) const {return((flags & aFlag) != 0);}
+
+    /// Dedicated allocations and vkBind*Memory2 are core from 1.1 and need no flag there
+    bool usesDedicatedAllocation() const {return(vulkanApiVersion >= VK_API_VERSION_1_1 || hasFlag(VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT));}
+    bool usesBindMemory2() const {return(vulkanApiVersion >= VK_API_VERSION_1_1 || hasFlag(VMA_ALLOCATOR_CREATE_KHR_BIND_MEMORY2_BIT));}
+
+    /// e.g. "Vulkan 1.2: dedicated allocation, bind memory 2, memory budget"
+    std::string describe() const;
+};
 
 template<>
 struct std::hash<VulkanDeviceHandlePair>{
@@ -16,15 +47,19 @@ struct std::hash<VulkanDeviceHandlePair>{
     }
 };
 
-class VmaHost : public std::unordered_map<VulkanDeviceHandlePair, VmaAllocator>
+/// Process wide registry of one VmaAllocator per device. Lookups of an existing allocator scan a fixed
+/// array of atomic slots and take no lock; creation and destruction serialize on a writer mutex.
+/// Destroying a device's allocator must not race with other users of that same allocator.
+class VmaHost
 {
  public:
 
-    using base_map_t = typename std::unordered_map<VulkanDeviceHandlePair, VmaAllocator>;
-
     ~VmaHost(){
-        for(auto& entry : *this){
-            vmaDestroyAllocator(entry.second);
+        for(_AllocatorSlot& slot : _mSlots){
+            VmaAllocator allocator = slot.allocator.load(std::memory_order_acquire);
+            if(allocator == nullptr) continue;
+            for(const std::pair<const std::string, VmaPool>& pool : slot.pools) vmaDestroyPool(allocator, pool.second);
+            vmaDestroyAllocator(allocator);
         }
     }
 
@@ -33,8 +68,11 @@ class VmaHost : public std::unordered_map<VulkanDeviceHandlePair, VmaAllocator>
         return(instance);
     }
 
-	static void setVkInstance(VkInstance aVkInstance) {
-		VmaHost::getInstance()._mInstance = aVkInstance;
+	/// \param aApiVersion VkApplicationInfo::apiVersion aVkInstance was created with. Allocators never use a
+	/// newer version, since Vulkan offers no way to query it from the instance.
+	static void setVkInstance(VkInstance aVkInstance, uint32_t aApiVersion = VMA_HOST_DEFAULT_INSTANCE_API_VERSION) {
+		VmaHost::getInstance()._mInstanceApiVersion.store(aApiVersion, std::memory_order_relaxed);
+		VmaHost::getInstance()._mInstance.store(aVkInstance, std::memory_order_release);
 	}
 
     static bool allocatorExists(const VulkanDeviceHandlePair& aDevicePair){
@@ -45,8 +83,38 @@ class VmaHost : public std::unordered_map<VulkanDeviceHandlePair, VmaAllocator>
         return(VmaHost::getInstance()._getAllocator(aDevicePair));
     }
 
-    static void destroyAllocator(const VulkanDeviceHandlePair& aDevicePair){
-        VmaHost::getInstance()._destroyAllocator(aDevicePair);
+    /// Destroys the allocator and its remaining named pools. Refuses with a warning while any named pool still
+    /// holds allocations, since their owners, e.g. a TransientPool, would later free them through it.
+    /// \returns False if the allocator was kept for that reason
+    static bool destroyAllocator(const VulkanDeviceHandlePair& aDevicePair){
+        return(VmaHost::getInstance()._destroyAllocator(aDevicePair));
+    }
+
+    /// API version and flags of the device's allocator, creating the allocator if needed
+    static VmaAllocatorConfig getAllocatorConfig(const VulkanDeviceHandlePair& aDevicePair){
+        return(VmaHost::getInstance()._getAllocatorConfig(aDevicePair));
+    }
+
+    /// Create a custom pool named aName in the device's allocator, creating the allocator if needed.
+    /// Throws if the device already has a pool of that name. Pools left over are destroyed with the allocator.
+    static VmaPool createPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName, const VmaPoolCreateInfo& aCreateInfo){
+        return(VmaHost::getInstance()._createPool(aDevicePair, aName, aCreateInfo));
+    }
+
+    /// \returns VK_NULL_HANDLE if the device has no pool named aName
+    static VmaPool getPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName){
+        return(VmaHost::getInstance()._getPool(aDevicePair, aName));
+    }
+
+    /// Every allocation in the pool must have been freed
+    static void destroyPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName){
+        VmaHost::getInstance()._destroyPool(aDevicePair, aName);
+    }
+
+    /// Destroy aPool if it is still one of the device's named pools. Unlike the name, the handle cannot refer
+    /// to a pool created later by someone else, so owners of a pool should destroy it through this overload.
+    static void destroyPool(const VulkanDeviceHandlePair& aDevicePair, VmaPool aPool){
+        VmaHost::getInstance()._destroyPool(aDevicePair, aPool);
     }
 
     VmaHost(const VmaHost&) = delete;
@@ -55,12 +123,50 @@ class VmaHost : public std::unordered_map<VulkanDeviceHandlePair, VmaAllocator>
  private:
     VmaHost(){}
 
+    /// Slots are guarded by a sequence lock. Writers make the sequence odd while they change a slot, and a reader
+    /// only trusts what it read if the sequence was even and unchanged around the reads, so it never pairs the
+    /// device of one allocator with the allocator of a later one.
+    struct _AllocatorSlot
+    {
+        void beginWrite(){
+            sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        void endWrite(){
+            sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<VkDevice> device{VK_NULL_HANDLE};
+        std::atomic<VkPhysicalDevice> physicalDevice{VK_NULL_HANDLE};
+        std::atomic<VmaAllocator> allocator{nullptr};
+
+        // Named custom pools and the negotiated config, only accessed under _mWriteMutex
+        std::unordered_map<std::string, VmaPool> pools;
+        VmaAllocatorConfig config;
+    };
+
     VmaAllocator _getAllocator(const VulkanDeviceHandlePair& aDevicePair);
-    VmaAllocator _createNewAllocator(const VulkanDeviceHandlePair& aDevicePair);
-    void _destroyAllocator(const VulkanDeviceHandlePair& aDevicePair);
+    VmaAllocator _findAllocator(const VulkanDeviceHandlePair& aDevicePair) const;
+    VmaAllocator _createNewAllocator(const VulkanDeviceHandlePair& aDevicePair, const VmaAllocatorConfig& aConfig);
+    VmaAllocatorConfig _negotiateConfig(const VulkanDeviceHandlePair& aDevicePair) const;
+    VmaAllocatorConfig _getAllocatorConfig(const VulkanDeviceHandlePair& aDevicePair);
+    bool _destroyAllocator(const VulkanDeviceHandlePair& aDevicePair);
     bool _allocatorExists(const VulkanDeviceHandlePair& aDevicePair);
 
-	VkInstance _mInstance = VK_NULL_HANDLE;
+    VmaPool _createPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName, const VmaPoolCreateInfo& aCreateInfo);
+    VmaPool _getPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName);
+    void _destroyPool(const VulkanDeviceHandlePair& aDevicePair, const std::string& aName);
+    void _destroyPool(const VulkanDeviceHandlePair& aDevicePair, VmaPool aPool);
+
+    /// Published slot of aDevicePair, or nullptr. Call with _mWriteMutex held.
+    _AllocatorSlot* _findSlotLocked(const VulkanDeviceHandlePair& aDevicePair);
+
+	std::atomic<VkInstance> _mInstance{VK_NULL_HANDLE};
+	std::atomic<uint32_t> _mInstanceApiVersion{VMA_HOST_DEFAULT_INSTANCE_API_VERSION};
+
+    std::array<_AllocatorSlot, VMA_HOST_MAX_DEVICES> _mSlots;
+    std::mutex _mWriteMutex;
 };
 
-#endif
\ No newline at end of file
+#endif
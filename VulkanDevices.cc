@@ -1,8 +1,17 @@
 #include "VulkanDevices.h"
 #include <set>
 #include <algorithm>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstring>
+#include <cstddef>
+#include <cassert>
 
-namespace vkutils{const char* vk_result_str(VkResult);}
+namespace vkutils{
+const char* vk_result_str(VkResult);
+void find_feature_matches(const VulkanFeatureChain&, const VulkanFeatureChain&, const VulkanFeatureChain&, VulkanFeatureChain&);
+}
 
 QueueFamily::QueueFamily(const VkQueueFamilyProperties& aFamily, uint32_t aIndex) 
 : mIndex(aIndex),
@@ -17,18 +26,453 @@ QueueFamily::QueueFamily(const VkQueueFamilyProperties& aFamily, uint32_t aIndex
   mProtected(aFamily.queueFlags & VK_QUEUE_PROTECTED_BIT)
 {}
 
-VulkanPhysicalDevice::VulkanPhysicalDevice(VkPhysicalDevice aDevice) : mHandle(aDevice) {
+PropertyNameIndex::PropertyNameIndex(const std::vector<VkExtensionProperties>& aExtensions){
+    std::vector<std::string> names;
+    names.reserve(aExtensions.size());
+    for(const VkExtensionProperties& extension : aExtensions) names.emplace_back(extension.extensionName);
+    _build(std::move(names));
+}
+
+PropertyNameIndex::PropertyNameIndex(const std::vector<VkLayerProperties>& aLayers){
+    std::vector<std::string> names;
+    names.reserve(aLayers.size());
+    for(const VkLayerProperties& layer : aLayers) names.emplace_back(layer.layerName);
+    _build(std::move(names));
+}
+
+PropertyNameIndex::PropertyNameIndex(const std::vector<const char*>& aNames){
+    _build(std::vector<std::string>(aNames.begin(), aNames.end()));
+}
+
+void PropertyNameIndex::_build(std::vector<std::string>&& aNames){
+    std::shared_ptr<_Names> index = std::make_shared<_Names>();
+    index->names = std::move(aNames);
+    index->lookup.reserve(index->names.size());
+    for(const std::string& name : index->names) index->lookup.emplace(name);
+    _mNames = std::move(index);
+}
+
+const char* PropertyNameIndex::find(std::string_view aName) const{
+    if(!_mNames) return(nullptr);
+    std::unordered_set<std::string_view>::const_iterator match = _mNames->lookup.find(aName);
+    return(match == _mNames->lookup.end() ? nullptr : match->data());
+}
+
+const PropertyNameIndex& PropertyNameIndex::instanceLayers(){
+    static const PropertyNameIndex sIndex = [](){
+        uint32_t layerCount = 0;
+        vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+        std::vector<VkLayerProperties> layers(layerCount);
+        vkEnumerateInstanceLayerProperties(&layerCount, layers.data());
+        layers.resize(layerCount);
+        return(PropertyNameIndex(layers));
+    }();
+    return(sIndex);
+}
+
+const PropertyNameIndex& PropertyNameIndex::instanceExtensions(){
+    static const PropertyNameIndex sIndex = [](){
+        uint32_t extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+        extensions.resize(extensionCount);
+        return(PropertyNameIndex(extensions));
+    }();
+    return(sIndex);
+}
+
+// Offsets of the 1.1, 1.2 and 1.3 structs within VulkanFeatureChain::ExtendedFeatureBits
+static constexpr size_t sVulkan11First = 0;
+static constexpr size_t sVulkan12First = 12;
+static constexpr size_t sVulkan13First = 12 + 47;
+
+static const char* const sExtendedFeatureNames[VulkanFeatureChain::sExtendedFeatureCount] = {
+    "Vulkan11.storageBuffer16BitAccess",
+    "Vulkan11.uniformAndStorageBuffer16BitAccess",
+    "Vulkan11.storagePushConstant16",
+    "Vulkan11.storageInputOutput16",
+    "Vulkan11.multiview",
+    "Vulkan11.multiviewGeometryShader",
+    "Vulkan11.multiviewTessellationShader",
+    "Vulkan11.variablePointersStorageBuffer",
+    "Vulkan11.variablePointers",
+    "Vulkan11.protectedMemory",
+    "Vulkan11.samplerYcbcrConversion",
+    "Vulkan11.shaderDrawParameters",
+    "Vulkan12.samplerMirrorClampToEdge",
+    "Vulkan12.drawIndirectCount",
+    "Vulkan12.storageBuffer8BitAccess",
+    "Vulkan12.uniformAndStorageBuffer8BitAccess",
+    "Vulkan12.storagePushConstant8",
+    "Vulkan12.shaderBufferInt64Atomics",
+    "Vulkan12.shaderSharedInt64Atomics",
+    "Vulkan12.shaderFloat16",
+    "Vulkan12.shaderInt8",
+    "Vulkan12.descriptorIndexing",
+    "Vulkan12.shaderInputAttachmentArrayDynamicIndexing",
+    "Vulkan12.shaderUniformTexelBufferArrayDynamicIndexing",
+    "Vulkan12.shaderStorageTexelBufferArrayDynamicIndexing",
+    "Vulkan12.shaderUniformBufferArrayNonUniformIndexing",
+    "Vulkan12.shaderSampledImageArrayNonUniformIndexing",
+    "Vulkan12.shaderStorageBufferArrayNonUniformIndexing",
+    "Vulkan12.shaderStorageImageArrayNonUniformIndexing",
+    "Vulkan12.shaderInputAttachmentArrayNonUniformIndexing",
+    "Vulkan12.shaderUniformTexelBufferArrayNonUniformIndexing",
+    "Vulkan12.shaderStorageTexelBufferArrayNonUniformIndexing",
+    "Vulkan12.descriptorBindingUniformBufferUpdateAfterBind",
+    "Vulkan12.descriptorBindingSampledImageUpdateAfterBind",
+    "Vulkan12.descriptorBindingStorageImageUpdateAfterBind",
+    "Vulkan12.descriptorBindingStorageBufferUpdateAfterBind",
+    "Vulkan12.descriptorBindingUniformTexelBufferUpdateAfterBind",
+    "Vulkan12.descriptorBindingStorageTexelBufferUpdateAfterBind",
+    "Vulkan12.descriptorBindingUpdateUnusedWhilePending",
+    "Vulkan12.descriptorBindingPartiallyBound",
+    "Vulkan12.descriptorBindingVariableDescriptorCount",
+    "Vulkan12.runtimeDescriptorArray",
+    "Vulkan12.samplerFilterMinmax",
+    "Vulkan12.scalarBlockLayout",
+    "Vulkan12.imagelessFramebuffer",
+    "Vulkan12.uniformBufferStandardLayout",
+    "Vulkan12.shaderSubgroupExtendedTypes",
+    "Vulkan12.separateDepthStencilLayouts",
+    "Vulkan12.hostQueryReset",
+    "Vulkan12.timelineSemaphore",
+    "Vulkan12.bufferDeviceAddress",
+    "Vulkan12.bufferDeviceAddressCaptureReplay",
+    "Vulkan12.bufferDeviceAddressMultiDevice",
+    "Vulkan12.vulkanMemoryModel",
+    "Vulkan12.vulkanMemoryModelDeviceScope",
+    "Vulkan12.vulkanMemoryModelAvailabilityVisibilityChains",
+    "Vulkan12.shaderOutputViewportIndex",
+    "Vulkan12.shaderOutputLayer",
+    "Vulkan12.subgroupBroadcastDynamicId",
+    "Vulkan13.robustImageAccess",
+    "Vulkan13.inlineUniformBlock",
+    "Vulkan13.descriptorBindingInlineUniformBlockUpdateAfterBind",
+    "Vulkan13.pipelineCreationCacheControl",
+    "Vulkan13.privateData",
+    "Vulkan13.shaderDemoteToHelperInvocation",
+    "Vulkan13.shaderTerminateInvocation",
+    "Vulkan13.subgroupSizeControl",
+    "Vulkan13.computeFullSubgroups",
+    "Vulkan13.synchronization2",
+    "Vulkan13.textureCompressionASTC_HDR",
+    "Vulkan13.shaderZeroInitializeWorkgroupMemory",
+    "Vulkan13.dynamicRendering",
+    "Vulkan13.shaderIntegerDotProduct",
+    "Vulkan13.maintenance4",
+};
+
+static constexpr size_t sNoFeature = std::numeric_limits<size_t>::max();
+
+/// An extension feature struct whose members were folded into one of the VulkanXXFeatures structs
+struct PromotedFeatureStruct
+{
+    VkStructureType sType;
+    const char* extension;    // nullptr for structs that were never part of an extension
+    uint32_t coreVersion;     // First version with the struct in core, no extension needed
+    uint32_t foldedVersion;   // First version whose VulkanXXFeatures struct replaces it in the chain
+    size_t firstFeature;      // Extended feature index of its first member
+    size_t count;
+    size_t extensionFeature;  // Extended feature standing for the extension as a whole, or sNoFeature
+};
+
+static const PromotedFeatureStruct sPromotedFeatureStructs[] = {
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES, "VK_KHR_16bit_storage", VK_API_VERSION_1_1, VK_API_VERSION_1_2, sVulkan11First + 0, 4, sNoFeature},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES, "VK_KHR_multiview", VK_API_VERSION_1_1, VK_API_VERSION_1_2, sVulkan11First + 4, 3, sNoFeature},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VARIABLE_POINTERS_FEATURES, "VK_KHR_variable_pointers", VK_API_VERSION_1_1, VK_API_VERSION_1_2, sVulkan11First + 7, 2, sNoFeature},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROTECTED_MEMORY_FEATURES, nullptr, VK_API_VERSION_1_1, VK_API_VERSION_1_2, sVulkan11First + 9, 1, sNoFeature},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES, "VK_KHR_sampler_ycbcr_conversion", VK_API_VERSION_1_1, VK_API_VERSION_1_2, sVulkan11First + 10, 1, sNoFeature},
+    // VK_KHR_shader_draw_parameters has no feature struct, the extension alone enables the feature before 1.1
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES, nullptr, VK_API_VERSION_1_1, VK_API_VERSION_1_2, sVulkan11First + 11, 1, sNoFeature},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_8BIT_STORAGE_FEATURES, "VK_KHR_8bit_storage", VK_API_VERSION_1_2, VK_API_VERSION_1_2, sVulkan12First + 2, 3, sNoFeature},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES, "VK_EXT_descriptor_indexing", VK_API_VERSION_1_2, VK_API_VERSION_1_2, sVulkan12First + 10, 20, sVulkan12First + 9},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES, "VK_KHR_timeline_semaphore", VK_API_VERSION_1_2, VK_API_VERSION_1_2, sVulkan12First + 37, 1, sNoFeature},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES, "VK_KHR_buffer_device_address", VK_API_VERSION_1_2, VK_API_VERSION_1_2, sVulkan12First + 38, 3, sNoFeature},
+    {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES, "VK_KHR_synchronization2", VK_API_VERSION_1_3, VK_API_VERSION_1_3, sVulkan13First + 9, 1, sNoFeature},
+};
+
+// Every feature struct in the chain is a run of VkBool32 directly after sType and pNext
+static_assert(offsetof(VkPhysicalDeviceVulkan11Features, storageBuffer16BitAccess) == sizeof(VkBaseOutStructure), "Unexpected VkPhysicalDeviceVulkan11Features layout");
+static_assert(offsetof(VkPhysicalDeviceVulkan11Features, shaderDrawParameters) == sizeof(VkBaseOutStructure) + 11 * sizeof(VkBool32), "Unexpected VkPhysicalDeviceVulkan11Features layout");
+static_assert(offsetof(VkPhysicalDeviceVulkan12Features, samplerMirrorClampToEdge) == sizeof(VkBaseOutStructure), "Unexpected VkPhysicalDeviceVulkan12Features layout");
+static_assert(offsetof(VkPhysicalDeviceVulkan12Features, subgroupBroadcastDynamicId) == sizeof(VkBaseOutStructure) + 46 * sizeof(VkBool32), "Unexpected VkPhysicalDeviceVulkan12Features layout");
+static_assert(offsetof(VkPhysicalDeviceVulkan13Features, robustImageAccess) == sizeof(VkBaseOutStructure), "Unexpected VkPhysicalDeviceVulkan13Features layout");
+static_assert(offsetof(VkPhysicalDeviceVulkan13Features, maintenance4) == sizeof(VkBaseOutStructure) + 14 * sizeof(VkBool32), "Unexpected VkPhysicalDeviceVulkan13Features layout");
+static_assert(offsetof(VkPhysicalDevice16BitStorageFeatures, storageInputOutput16) == sizeof(VkBaseOutStructure) + 3 * sizeof(VkBool32), "Unexpected VkPhysicalDevice16BitStorageFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceMultiviewFeatures, multiviewTessellationShader) == sizeof(VkBaseOutStructure) + 2 * sizeof(VkBool32), "Unexpected VkPhysicalDeviceMultiviewFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceVariablePointersFeatures, variablePointers) == sizeof(VkBaseOutStructure) + sizeof(VkBool32), "Unexpected VkPhysicalDeviceVariablePointersFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceProtectedMemoryFeatures, protectedMemory) == sizeof(VkBaseOutStructure), "Unexpected VkPhysicalDeviceProtectedMemoryFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceSamplerYcbcrConversionFeatures, samplerYcbcrConversion) == sizeof(VkBaseOutStructure), "Unexpected VkPhysicalDeviceSamplerYcbcrConversionFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceShaderDrawParametersFeatures, shaderDrawParameters) == sizeof(VkBaseOutStructure), "Unexpected VkPhysicalDeviceShaderDrawParametersFeatures layout");
+static_assert(offsetof(VkPhysicalDevice8BitStorageFeatures, storagePushConstant8) == sizeof(VkBaseOutStructure) + 2 * sizeof(VkBool32), "Unexpected VkPhysicalDevice8BitStorageFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceDescriptorIndexingFeatures, runtimeDescriptorArray) == sizeof(VkBaseOutStructure) + 19 * sizeof(VkBool32), "Unexpected VkPhysicalDeviceDescriptorIndexingFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceTimelineSemaphoreFeatures, timelineSemaphore) == sizeof(VkBaseOutStructure), "Unexpected VkPhysicalDeviceTimelineSemaphoreFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceBufferDeviceAddressFeatures, bufferDeviceAddressMultiDevice) == sizeof(VkBaseOutStructure) + 2 * sizeof(VkBool32), "Unexpected VkPhysicalDeviceBufferDeviceAddressFeatures layout");
+static_assert(offsetof(VkPhysicalDeviceSynchronization2Features, synchronization2) == sizeof(VkBaseOutStructure), "Unexpected VkPhysicalDeviceSynchronization2Features layout");
+
+template<typename FeatureStruct>
+static const VkBool32* feature_values(const FeatureStruct& aStruct){
+    return(reinterpret_cast<const VkBool32*>(reinterpret_cast<const char*>(&aStruct) + sizeof(VkBaseOutStructure)));
+}
+
+VulkanFeatureChain::VulkanFeatureChain(){
+    static_assert(sizeof(sPromotedFeatureStructs) / sizeof(sPromotedFeatureStructs[0]) == sPromotedStructCount, "sPromotedFeatureStructs and mPromoted disagree");
+    static_assert(offsetof(_PromotedFeatures, values) == sizeof(VkBaseOutStructure), "Unexpected _PromotedFeatures layout");
+
+    mFeatures2 = {};
+    mFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    mVulkan11 = {};
+    mVulkan11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    mVulkan12 = {};
+    mVulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    mVulkan13 = {};
+    mVulkan13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    for(size_t i = 0; i < sPromotedStructCount; ++i){
+        mPromoted[i] = {};
+        mPromoted[i].sType = sPromotedFeatureStructs[i].sType;
+    }
+}
+
+VulkanFeatureChain::VulkanFeatureChain(const VkPhysicalDeviceFeatures& aFeatures) : VulkanFeatureChain() {
+    mFeatures2.features = aFeatures;
+}
+
+VulkanFeatureChain::VulkanFeatureChain(const VulkanFeatureChain& aOther)
+: mFeatures2(aOther.mFeatures2), mVulkan11(aOther.mVulkan11), mVulkan12(aOther.mVulkan12), mVulkan13(aOther.mVulkan13),
+  mMemoryPriority(aOther.mMemoryPriority)
+{
+    std::copy(aOther.mPromoted, aOther.mPromoted + sPromotedStructCount, mPromoted);
+    _unlink();
+}
+
+VulkanFeatureChain& VulkanFeatureChain::operator=(const VulkanFeatureChain& aOther){
+    if(this != &aOther){
+        mFeatures2 = aOther.mFeatures2;
+        mVulkan11 = aOther.mVulkan11;
+        mVulkan12 = aOther.mVulkan12;
+        mVulkan13 = aOther.mVulkan13;
+        std::copy(aOther.mPromoted, aOther.mPromoted + sPromotedStructCount, mPromoted);
+        mMemoryPriority = aOther.mMemoryPriority;
+    }
+    _unlink();
+    return(*this);
+}
+
+void VulkanFeatureChain::_unlink(){
+    mFeatures2.pNext = nullptr;
+    mVulkan11.pNext = nullptr;
+    mVulkan12.pNext = nullptr;
+    mVulkan13.pNext = nullptr;
+    for(_PromotedFeatures& promoted : mPromoted) promoted.pNext = nullptr;
+}
+
+void** VulkanFeatureChain::_linkCore(uint32_t aApiVersion){
+    _unlink();
+    void** tail = &mFeatures2.pNext;
+    if(aApiVersion >= VK_API_VERSION_1_2){
+        *tail = &mVulkan11;
+        tail = &mVulkan11.pNext;
+        *tail = &mVulkan12;
+        tail = &mVulkan12.pNext;
+    }
+    if(aApiVersion >= VK_API_VERSION_1_3){
+        *tail = &mVulkan13;
+        tail = &mVulkan13.pNext;
+    }
+    return(tail);
+}
+
+const VkBool32& VulkanFeatureChain::_extendedFeature(size_t aIndex) const{
+    assert(aIndex < sExtendedFeatureCount);
+    if(aIndex < sVulkan12First) return(feature_values(mVulkan11)[aIndex - sVulkan11First]);
+    if(aIndex < sVulkan13First) return(feature_values(mVulkan12)[aIndex - sVulkan12First]);
+    return(feature_values(mVulkan13)[aIndex - sVulkan13First]);
+}
+
+VulkanFeatureChain::ExtendedFeatureBits VulkanFeatureChain::getExtendedBits() const{
+    ExtendedFeatureBits bits;
+    for(size_t i = 0; i < sExtendedFeatureCount; ++i){
+        bits[i] = _extendedFeature(i) != VK_FALSE;
+    }
+    return(bits);
+}
+
+void VulkanFeatureChain::setExtendedBits(const ExtendedFeatureBits& aBits){
+    for(size_t i = 0; i < sExtendedFeatureCount; ++i){
+        _extendedFeature(i) = aBits[i] ? VK_TRUE : VK_FALSE;
+    }
+}
+
+const char* VulkanFeatureChain::getExtendedFeatureName(size_t aIndex){
+    return(aIndex < sExtendedFeatureCount ? sExtendedFeatureNames[aIndex] : "unknown");
+}
+
+VulkanFeatureChain VulkanFeatureChain::query(VkPhysicalDevice aDevice, uint32_t aApiVersion, const PropertyNameIndex& aExtensions){
+    VulkanFeatureChain chain;
+    if(aApiVersion < VK_API_VERSION_1_1){
+        vkGetPhysicalDeviceFeatures(aDevice, &chain.mFeatures2.features);
+        return(chain);
+    }
+
+    bool linked[sPromotedStructCount] = {};
+    void** tail = chain._linkCore(aApiVersion);
+    for(size_t i = 0; i < sPromotedStructCount; ++i){
+        const PromotedFeatureStruct& promoted = sPromotedFeatureStructs[i];
+        if(aApiVersion >= promoted.foldedVersion) continue;
+        if(aApiVersion < promoted.coreVersion && !aExtensions.contains(promoted.extension)) continue;
+
+        *tail = &chain.mPromoted[i];
+        tail = &chain.mPromoted[i].pNext;
+        linked[i] = true;
+    }
+
+    vkGetPhysicalDeviceFeatures2(aDevice, &chain.mFeatures2);
+    chain._unlink();
+
+    // Report features exposed through extension structs in their core members
+    for(size_t i = 0; i < sPromotedStructCount; ++i){
+        if(!linked[i]) continue;
+        const PromotedFeatureStruct& promoted = sPromotedFeatureStructs[i];
+        for(size_t j = 0; j < promoted.count; ++j){
+            chain._extendedFeature(promoted.firstFeature + j) = chain.mPromoted[i].values[j];
+        }
+        if(promoted.extensionFeature != sNoFeature) chain._extendedFeature(promoted.extensionFeature) = VK_TRUE;
+    }
+    return(chain);
+}
+
+VulkanFeatureChain VulkanFeatureChain::fromCreateInfo(const VkDeviceCreateInfo& aCreateInfo){
+    VulkanFeatureChain chain;
+    if(aCreateInfo.pEnabledFeatures != nullptr) chain.mFeatures2.features = *aCreateInfo.pEnabledFeatures;
+
+    for(const VkBaseOutStructure* entry = static_cast<const VkBaseOutStructure*>(aCreateInfo.pNext); entry != nullptr; entry = entry->pNext){
+        switch(entry->sType){
+            case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2:
+                chain.mFeatures2.features = reinterpret_cast<const VkPhysicalDeviceFeatures2*>(entry)->features;
+                break;
+            case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES:
+                chain.mVulkan11 = *reinterpret_cast<const VkPhysicalDeviceVulkan11Features*>(entry);
+                break;
+            case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES:
+                chain.mVulkan12 = *reinterpret_cast<const VkPhysicalDeviceVulkan12Features*>(entry);
+                break;
+            case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES:
+                chain.mVulkan13 = *reinterpret_cast<const VkPhysicalDeviceVulkan13Features*>(entry);
+                break;
+            case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT:
+                chain.mMemoryPriority = reinterpret_cast<const VkPhysicalDeviceMemoryPriorityFeaturesEXT*>(entry)->memoryPriority;
+                break;
+            default:
+                // Raise extension structs into their core members, as query() does
+                for(const PromotedFeatureStruct& promoted : sPromotedFeatureStructs){
+                    if(promoted.sType != entry->sType) continue;
+                    for(size_t j = 0; j < promoted.count; ++j){
+                        chain._extendedFeature(promoted.firstFeature + j) = feature_values(*entry)[j];
+                    }
+                    if(promoted.extensionFeature != sNoFeature) chain._extendedFeature(promoted.extensionFeature) = VK_TRUE;
+                }
+                break;
+        }
+    }
+    chain._unlink();
+    return(chain);
+}
+
+VkPhysicalDeviceFeatures2* VulkanFeatureChain::link(uint32_t aApiVersion, std::vector<const char*>& aExtensionsInOut, void* aTail){
+    if(aApiVersion < VK_API_VERSION_1_1) return(nullptr);
+
+    void** tail = _linkCore(aApiVersion);
+    for(size_t i = 0; i < sPromotedStructCount; ++i){
+        const PromotedFeatureStruct& promoted = sPromotedFeatureStructs[i];
+        if(aApiVersion >= promoted.foldedVersion) continue;
+
+        // Lower the core members into the extension struct, and only chain it if something in it is enabled
+        bool enabled = promoted.extensionFeature != sNoFeature && _extendedFeature(promoted.extensionFeature) != VK_FALSE;
+        for(size_t j = 0; j < promoted.count; ++j){
+            mPromoted[i].values[j] = _extendedFeature(promoted.firstFeature + j);
+            enabled = enabled || mPromoted[i].values[j] != VK_FALSE;
+        }
+        if(!enabled) continue;
+
+        *tail = &mPromoted[i];
+        tail = &mPromoted[i].pNext;
+
+        if(aApiVersion < promoted.coreVersion){
+            auto streq = [&promoted](const char* aName) -> bool {return(std::strcmp(aName, promoted.extension) == 0);};
+            if(std::none_of(aExtensionsInOut.begin(), aExtensionsInOut.end(), streq)){
+                aExtensionsInOut.push_back(promoted.extension);
+            }
+        }
+    }
+    *tail = aTail;
+    return(&mFeatures2);
+}
+
+VulkanPhysicalDevice::VulkanPhysicalDevice(VkPhysicalDevice aDevice, uint32_t aInstanceApiVersion) : mHandle(aDevice) {
     vkGetPhysicalDeviceProperties(aDevice, &mProperties);
-    vkGetPhysicalDeviceFeatures(aDevice, &mFeatures);
+    // Functionality newer than the instance's version must not be used, even when the device supports it
+    mApiVersion = std::min(aInstanceApiVersion, mProperties.apiVersion);
+    vkGetPhysicalDeviceMemoryProperties(aDevice, &mMemoryProperties);
+    _initSubgroupProps();
     _initExtensionProps();
+    mFeatureChain = VulkanFeatureChain::query(aDevice, mApiVersion, mExtensionIndex);
+    // The chain already carries the core features, querying them again would be redundant
+    mFeatures = mFeatureChain.core();
     _initQueueFamilies();
 }
 
+// Keyed by instance as well, since a destroyed instance's physical device handles can be reused by the next one
+static std::mutex sPhysicalDeviceCacheMutex;
+static std::map<std::pair<VkInstance, VkPhysicalDevice>, std::unique_ptr<VulkanPhysicalDevice>> sPhysicalDeviceCache;
+
+const VulkanPhysicalDevice& VulkanPhysicalDevice::getCached(VkPhysicalDevice aDevice, VkInstance aInstance, uint32_t aInstanceApiVersion){
+    if(aInstance == VK_NULL_HANDLE) throw std::runtime_error("Physical device snapshots are only cached per instance!");
+    std::lock_guard<std::mutex> lock(sPhysicalDeviceCacheMutex);
+    std::unique_ptr<VulkanPhysicalDevice>& entry = sPhysicalDeviceCache[std::make_pair(aInstance, aDevice)];
+    if(entry == nullptr) entry = std::make_unique<VulkanPhysicalDevice>(aDevice, aInstanceApiVersion);
+    return(*entry);
+}
+
+VulkanPhysicalDevice VulkanPhysicalDevice::getSnapshot(VkPhysicalDevice aDevice, VkInstance aInstance, uint32_t aInstanceApiVersion){
+    if(aInstance == VK_NULL_HANDLE) return(VulkanPhysicalDevice(aDevice, aInstanceApiVersion));
+    return(getCached(aDevice, aInstance, aInstanceApiVersion));
+}
+
+void VulkanPhysicalDevice::clearCache(VkInstance aInstance){
+    std::lock_guard<std::mutex> lock(sPhysicalDeviceCacheMutex);
+    auto first = sPhysicalDeviceCache.lower_bound(std::make_pair(aInstance, VkPhysicalDevice(VK_NULL_HANDLE)));
+    auto last = first;
+    while(last != sPhysicalDeviceCache.end() && last->first.first == aInstance) ++last;
+    sPhysicalDeviceCache.erase(first, last);
+}
+
+void VulkanPhysicalDevice::clearCache(){
+    std::lock_guard<std::mutex> lock(sPhysicalDeviceCacheMutex);
+    sPhysicalDeviceCache.clear();
+}
+
+void VulkanPhysicalDevice::_initSubgroupProps(){
+    // Subgroup properties and vkGetPhysicalDeviceProperties2 are core in Vulkan 1.1
+    if(mApiVersion < VK_API_VERSION_1_1) return;
+
+    VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(mHandle, &properties2);
+    mSubgroupSize = subgroupProperties.subgroupSize;
+}
+
 void VulkanPhysicalDevice::_initExtensionProps(){
     uint32_t extensionCount = 0;
     vkEnumerateDeviceExtensionProperties(mHandle, nullptr, &extensionCount, nullptr);
     mAvailableExtensions.resize(extensionCount);
     vkEnumerateDeviceExtensionProperties(mHandle, nullptr, &extensionCount, mAvailableExtensions.data());
+    mAvailableExtensions.resize(extensionCount);
+    mExtensionIndex = PropertyNameIndex(mAvailableExtensions);
 }
 void VulkanPhysicalDevice::_initQueueFamilies(){
     uint32_t queueCount = 0;
@@ -53,7 +497,36 @@ void VulkanPhysicalDevice::_initQueueFamilies(){
         if(!mSparseBindIdx && queueFamily.mSparseBinding)
             mSparseBindIdx = familyIdx;
     }
+
+    // Families dedicated to compute and transfer, only used once useDedicatedQueueFamilies() is called
+    mDedicatedComputeIdx = _selectQueueFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    mDedicatedTransferIdx = _selectQueueFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 }
+
+void VulkanPhysicalDevice::useDedicatedQueueFamilies(){
+    if(mDedicatedComputeIdx) mComputeIdx = mDedicatedComputeIdx;
+    if(mDedicatedTransferIdx) mTransferIdx = mDedicatedTransferIdx;
+}
+
+opt::optional<uint32_t> VulkanPhysicalDevice::_selectQueueFamily(VkQueueFlags aRequired, VkQueueFlags aAvoided) const{
+    opt::optional<uint32_t> bestIdx;
+    int bestAvoidedCount = std::numeric_limits<int>::max();
+    for(const QueueFamily& family : mQueueFamilies){
+        if((family.mFlags & aRequired) != aRequired) continue;
+
+        // Fewer unwanted capabilities means a more dedicated family. Ties go to the lower index.
+        int avoidedCount = 0;
+        for(VkQueueFlags bit = 1; bit <= aAvoided; bit <<= 1){
+            if(aAvoided & family.mFlags & bit) ++avoidedCount;
+        }
+        if(avoidedCount < bestAvoidedCount){
+            bestIdx = family.mIndex;
+            bestAvoidedCount = avoidedCount;
+        }
+    }
+    return(bestIdx);
+}
+
 SwapChainSupportInfo VulkanPhysicalDevice::getSwapChainSupportInfo(const VkSurfaceKHR aSurface) const{
     SwapChainSupportInfo info;
 
@@ -82,6 +555,23 @@ opt::optional<uint32_t> VulkanPhysicalDevice::getPresentableQueueIndex(const VkS
 }
 
 
+// Extensions and features of every device created here, keyed by handle. A handle reused by a later device is overwritten.
+struct EnabledDeviceState
+{
+    PropertyNameIndex extensions;
+    VulkanFeatureChain features;
+};
+static std::mutex sEnabledStateMutex;
+static std::unordered_map<VkDevice, EnabledDeviceState> sEnabledState;
+
+// Features must go through either pEnabledFeatures or a VkPhysicalDeviceFeatures2 in the pNext chain, not both
+static bool chain_has_features2(const void* aNext){
+    for(const VkBaseOutStructure* entry = static_cast<const VkBaseOutStructure*>(aNext); entry != nullptr; entry = entry->pNext){
+        if(entry->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2) return(true);
+    }
+    return(false);
+}
+
 VulkanLogicalDevice VulkanPhysicalDevice::createLogicalDevice(const VkDeviceCreateInfo& aDeviceCreateInfo, const std::optional<uint32_t>& aPresentationIdx) const{
     VkDevice deviceHandle = VK_NULL_HANDLE;
     VkResult deviceCreationResult;
@@ -91,9 +581,24 @@ VulkanLogicalDevice VulkanPhysicalDevice::createLogicalDevice(const VkDeviceCrea
     }
 
     VulkanLogicalDevice device = VulkanLogicalDevice(deviceHandle);
+    device.mEnabledExtensions = PropertyNameIndex(std::vector<const char*>(
+        aDeviceCreateInfo.ppEnabledExtensionNames,
+        aDeviceCreateInfo.ppEnabledExtensionNames + aDeviceCreateInfo.enabledExtensionCount
+    ));
+    device.mEnabledFeatures = VulkanFeatureChain::fromCreateInfo(aDeviceCreateInfo);
+    {
+        std::lock_guard<std::mutex> lock(sEnabledStateMutex);
+        sEnabledState[deviceHandle] = EnabledDeviceState{device.mEnabledExtensions, device.mEnabledFeatures};
+    }
 
     for(size_t i = 0; i < aDeviceCreateInfo.queueCreateInfoCount; ++i){
         const VkDeviceQueueCreateInfo& queueInfo = aDeviceCreateInfo.pQueueCreateInfos[i];
+        std::vector<VkQueue>& familyQueues = device.mFamilyQueues[queueInfo.queueFamilyIndex];
+        familyQueues.resize(queueInfo.queueCount);
+        for(uint32_t queueIdx = 0; queueIdx < queueInfo.queueCount; ++queueIdx){
+            vkGetDeviceQueue(deviceHandle, queueInfo.queueFamilyIndex, queueIdx, &familyQueues[queueIdx]);
+        }
+
         if(queueInfo.queueFamilyIndex == mGraphicsIdx && device.mGraphicsQueue == VK_NULL_HANDLE) 
             vkGetDeviceQueue(deviceHandle, *mGraphicsIdx, 0, &device.mGraphicsQueue);
         if(queueInfo.queueFamilyIndex == mComputeIdx && device.mComputeQueue == VK_NULL_HANDLE) 
@@ -116,14 +621,15 @@ VulkanLogicalDevice VulkanPhysicalDevice::createLogicalDevice(
     const std::vector<const char*>& aExtensions,
     const VkPhysicalDeviceFeatures& aFeatures,
     VkSurfaceKHR aSurface,
-    void* aDeviceCreateInfoPnext
+    void* aDeviceCreateInfoPnext,
+    const QueuePriorityMap& aQueuePriorities
 ) const{
     std::set<uint32_t> queueFamilyIndices;
-    if(aQueues | VK_QUEUE_GRAPHICS_BIT && mGraphicsIdx) queueFamilyIndices.emplace(*mGraphicsIdx);
-    if(aQueues | VK_QUEUE_COMPUTE_BIT && mComputeIdx) queueFamilyIndices.emplace(*mComputeIdx);
-    if(aQueues | VK_QUEUE_TRANSFER_BIT && mTransferIdx) queueFamilyIndices.emplace(*mTransferIdx);
-    if(aQueues | VK_QUEUE_PROTECTED_BIT && mProtectedIdx) queueFamilyIndices.emplace(*mProtectedIdx);
-    if(aQueues | VK_QUEUE_SPARSE_BINDING_BIT && mSparseBindIdx) queueFamilyIndices.emplace(*mSparseBindIdx);
+    if((aQueues & VK_QUEUE_GRAPHICS_BIT) && mGraphicsIdx) queueFamilyIndices.emplace(*mGraphicsIdx);
+    if((aQueues & VK_QUEUE_COMPUTE_BIT) && mComputeIdx) queueFamilyIndices.emplace(*mComputeIdx);
+    if((aQueues & VK_QUEUE_TRANSFER_BIT) && mTransferIdx) queueFamilyIndices.emplace(*mTransferIdx);
+    if((aQueues & VK_QUEUE_PROTECTED_BIT) && mProtectedIdx) queueFamilyIndices.emplace(*mProtectedIdx);
+    if((aQueues & VK_QUEUE_SPARSE_BINDING_BIT) && mSparseBindIdx) queueFamilyIndices.emplace(*mSparseBindIdx);
     
     opt::optional<uint32_t> presentationIdx;
     if(aSurface != VK_NULL_HANDLE){
@@ -135,16 +641,29 @@ VulkanLogicalDevice VulkanPhysicalDevice::createLogicalDevice(
         }
     }
 
-    float priorities = 1.0f;
+    // Families may also be requested through the priority map alone
+    for(const QueuePriorityMap::value_type& entry : aQueuePriorities){
+        if(entry.first >= mQueueFamilies.size()){
+            throw std::runtime_error("Queue priorities given for nonexistent queue family " + std::to_string(entry.first) + "!");
+        }
+        queueFamilyIndices.emplace(entry.first);
+    }
+
+    const std::vector<float> defaultPriorities = {1.0f};
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(queueFamilyIndices.size());
     std::set<uint32_t>::const_iterator famIter = queueFamilyIndices.begin();
     size_t i = 0;
     while(famIter != queueFamilyIndices.end()){
+        QueuePriorityMap::const_iterator finder = aQueuePriorities.find(*famIter);
+        const std::vector<float>& priorities = (finder == aQueuePriorities.end() || finder->second.empty()) ? defaultPriorities : finder->second;
+        uint32_t queueCount = std::min(static_cast<uint32_t>(priorities.size()), mQueueFamilies[*famIter].mCount);
+
         queueCreateInfos[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfos[i].pNext = nullptr;
-        queueCreateInfos[i].queueCount = 1;
+        queueCreateInfos[i].flags = 0;
+        queueCreateInfos[i].queueCount = queueCount;
         queueCreateInfos[i].queueFamilyIndex = *famIter;
-        queueCreateInfos[i].pQueuePriorities = &priorities;
+        queueCreateInfos[i].pQueuePriorities = priorities.data();
         ++famIter; ++i;
     }
 
@@ -152,7 +671,7 @@ VulkanLogicalDevice VulkanPhysicalDevice::createLogicalDevice(
     {
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         createInfo.pNext = aDeviceCreateInfoPnext;
-        createInfo.pEnabledFeatures = (aDeviceCreateInfoPnext == nullptr) ? &aFeatures : nullptr;
+        createInfo.pEnabledFeatures = chain_has_features2(aDeviceCreateInfoPnext) ? nullptr : &aFeatures;
         createInfo.flags = 0;
         createInfo.ppEnabledLayerNames = nullptr;
         createInfo.enabledLayerCount = 0;
@@ -165,9 +684,101 @@ VulkanLogicalDevice VulkanPhysicalDevice::createLogicalDevice(
     return(createLogicalDevice(createInfo, presentationIdx));
 }
 
-VulkanPhysicalDeviceEnumeration::VulkanPhysicalDeviceEnumeration(const std::vector<VkPhysicalDevice>& aDevices) {
-    base_vector::resize(aDevices.size());
+VulkanLogicalDevice VulkanPhysicalDevice::createLogicalDevice(
+    VkQueueFlags aQueues,
+    const std::vector<const char*>& aExtensions,
+    const VulkanFeatureChain& aRequired,
+    const VulkanFeatureChain& aRequested,
+    VkSurfaceKHR aSurface,
+    void* aDeviceCreateInfoPnext,
+    const QueuePriorityMap& aQueuePriorities
+) const{
+    VulkanFeatureChain enabledFeatures;
+    vkutils::find_feature_matches(mFeatureChain, aRequired, aRequested, enabledFeatures);
+
+    std::vector<const char*> extensions = aExtensions;
+    VkPhysicalDeviceFeatures2* featureChain = enabledFeatures.link(mApiVersion, extensions, aDeviceCreateInfoPnext);
+    if(featureChain == nullptr){
+        // Vulkan 1.0 only takes features through pEnabledFeatures
+        return(createLogicalDevice(aQueues, extensions, enabledFeatures.core(), aSurface, aDeviceCreateInfoPnext, aQueuePriorities));
+    }
+    return(createLogicalDevice(aQueues, extensions, VkPhysicalDeviceFeatures(), aSurface, featureChain, aQueuePriorities));
+}
+
+PropertyNameIndex VulkanLogicalDevice::findEnabledExtensions(VkDevice aDevice){
+    std::lock_guard<std::mutex> lock(sEnabledStateMutex);
+    std::unordered_map<VkDevice, EnabledDeviceState>::const_iterator finder = sEnabledState.find(aDevice);
+    return(finder == sEnabledState.end() ? PropertyNameIndex() : finder->second.extensions);
+}
+
+VulkanFeatureChain VulkanLogicalDevice::findEnabledFeatures(VkDevice aDevice){
+    std::lock_guard<std::mutex> lock(sEnabledStateMutex);
+    std::unordered_map<VkDevice, EnabledDeviceState>::const_iterator finder = sEnabledState.find(aDevice);
+    return(finder == sEnabledState.end() ? VulkanFeatureChain() : finder->second.features);
+}
+
+const std::vector<VkQueue>& VulkanLogicalDevice::getFamilyQueues(uint32_t aFamily) const{
+    static const std::vector<VkQueue> sNoQueues;
+    std::map<uint32_t, std::vector<VkQueue>>::const_iterator finder = mFamilyQueues.find(aFamily);
+    return(finder == mFamilyQueues.end() ? sNoQueues : finder->second);
+}
+
+QueuePool::QueuePool(const VulkanLogicalDevice& aDevice, uint32_t aFamily)
+: mFamily(aFamily), _mFree(aDevice.getFamilyQueues(aFamily))
+{
+    mQueueCount = _mFree.size();
+    if(mQueueCount == 0) throw std::runtime_error("Queue family " + std::to_string(aFamily) + " has no queues on this device!");
+}
+
+VkQueue QueuePool::acquire(){
+    std::unique_lock<std::mutex> lock(_mMutex);
+    _mCondition.wait(lock, [this](){return(!_mFree.empty());});
+    VkQueue queue = _mFree.back();
+    _mFree.pop_back();
+    return(queue);
+}
+
+VkQueue QueuePool::tryAcquire(){
+    std::lock_guard<std::mutex> lock(_mMutex);
+    if(_mFree.empty()) return(VK_NULL_HANDLE);
+    VkQueue queue = _mFree.back();
+    _mFree.pop_back();
+    return(queue);
+}
+
+void QueuePool::release(VkQueue aQueue){
+    {
+        std::lock_guard<std::mutex> lock(_mMutex);
+        _mFree.push_back(aQueue);
+    }
+    _mCondition.notify_one();
+}
+
+VulkanPhysicalDeviceEnumeration::VulkanPhysicalDeviceEnumeration(const std::vector<VkPhysicalDevice>& aDevices, VkInstance aInstance, uint32_t aInstanceApiVersion) {
+    base_vector::reserve(aDevices.size());
     for(VkPhysicalDevice device : aDevices){
-        base_vector::emplace_back(device);
+        base_vector::push_back(VulkanPhysicalDevice::getSnapshot(device, aInstance, aInstanceApiVersion));
+    }
+}
+
+VulkanPhysicalDeviceEnumeration::VulkanPhysicalDeviceEnumeration(VkInstance aInstance, uint32_t aInstanceApiVersion) {
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(aInstance, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(aInstance, &deviceCount, devices.data());
+    devices.resize(deviceCount);
+
+    base_vector::reserve(devices.size());
+    for(VkPhysicalDevice device : devices){
+        base_vector::push_back(VulkanPhysicalDevice::getSnapshot(device, aInstance, aInstanceApiVersion));
+    }
+}
+
+std::vector<VkPhysicalDevice> VulkanPhysicalDeviceEnumeration::handles() const{
+    std::vector<VkPhysicalDevice> result;
+    result.reserve(base_vector::size());
+    for(const VulkanPhysicalDevice& device : *this){
+        result.push_back(device.handle());
     }
+    return(result);
 }
\ No newline at end of file
@@ -3,8 +3,25 @@
 #include <vulkan/vulkan.h>
 #include "optional.h"
 #include <vector>
+#include <bitset>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <memory>
 #include <stdexcept>
 #include <limits>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+// Vulkan version of the VkInstance physical devices are queried through when the caller doesn't pass one
+#ifndef VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+#ifdef VULKAN_BASE_VK_API_VERSION
+#define VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION VULKAN_BASE_VK_API_VERSION
+#else
+#define VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION VK_API_VERSION_1_0
+#endif
+#endif
 
 class QueueFamily
 {
@@ -28,6 +45,10 @@ class QueueFamily
     bool mProtected = false;
 };
 
+/// Priorities of the queues to create in each family, keyed by family index. One queue is created
+/// per priority. Families without an entry get a single queue with priority 1.0.
+using QueuePriorityMap = std::map<uint32_t, std::vector<float>>;
+
 struct VulkanDeviceHandlePair
 {
    VkDevice device = VK_NULL_HANDLE;
@@ -42,6 +63,116 @@ struct VulkanDeviceHandlePair
    friend bool operator!=(const VulkanDeviceHandlePair& lhs, const VulkanDeviceHandlePair& rhs){return(!operator==(lhs, rhs));}
 };
 
+/// Hashed set of the names in a VkExtensionProperties or VkLayerProperties list, so availability checks are O(1).
+/// The names are stored once and shared between copies, so pointers returned by find() stay valid while any
+/// copy of the index is alive.
+class PropertyNameIndex
+{
+ public:
+    PropertyNameIndex(){}
+    explicit PropertyNameIndex(const std::vector<VkExtensionProperties>& aExtensions);
+    explicit PropertyNameIndex(const std::vector<VkLayerProperties>& aLayers);
+    explicit PropertyNameIndex(const std::vector<const char*>& aNames);
+
+    /// Layers and instance extensions reported by the loader, enumerated once on first use
+    static const PropertyNameIndex& instanceLayers();
+    static const PropertyNameIndex& instanceExtensions();
+
+    /// The index's own copy of aName, or nullptr if aName is not available
+    const char* find(std::string_view aName) const;
+    bool contains(std::string_view aName) const {return(find(aName) != nullptr);}
+    size_t size() const {return(_mNames ? _mNames->names.size() : 0);}
+
+ private:
+    struct _Names
+    {
+        std::vector<std::string> names;
+        // Views into names, which is never modified once the lookup is built
+        std::unordered_set<std::string_view> lookup;
+    };
+
+    void _build(std::vector<std::string>&& aNames);
+
+    std::shared_ptr<const _Names> _mNames;
+};
+
+/// VkPhysicalDeviceFeatures2 together with the Vulkan 1.1, 1.2 and 1.3 feature structs. Features are always
+/// stored in their core form. link() lowers them to the extension structs they were promoted from when the
+/// device is too old for the core struct, and query() raises those extension structs back into core form.
+class VulkanFeatureChain
+{
+ public:
+    /// Number of VkBool32 members across VkPhysicalDeviceVulkan11Features, 12Features and 13Features
+    static constexpr size_t sExtendedFeatureCount = 12 + 47 + 15;
+
+    /// Bit i is member i of the 1.1, 1.2 and 1.3 structs taken in order
+    using ExtendedFeatureBits = std::bitset<sExtendedFeatureCount>;
+
+    VulkanFeatureChain();
+    explicit VulkanFeatureChain(const VkPhysicalDeviceFeatures& aFeatures);
+    VulkanFeatureChain(const VulkanFeatureChain& aOther);
+    VulkanFeatureChain& operator=(const VulkanFeatureChain& aOther);
+
+    /// Features supported by aDevice. On devices older than the struct holding a feature, the feature is reported
+    /// through the extension it was promoted from, when aExtensions has that extension.
+    static VulkanFeatureChain query(VkPhysicalDevice aDevice, uint32_t aApiVersion, const PropertyNameIndex& aExtensions);
+
+    /// Features enabled by aCreateInfo, read from pEnabledFeatures or the feature structs in its pNext chain
+    static VulkanFeatureChain fromCreateInfo(const VkDeviceCreateInfo& aCreateInfo);
+
+    VkPhysicalDeviceFeatures& core() {return(mFeatures2.features);}
+    VkPhysicalDeviceVulkan11Features& vulkan11() {return(mVulkan11);}
+    VkPhysicalDeviceVulkan12Features& vulkan12() {return(mVulkan12);}
+    VkPhysicalDeviceVulkan13Features& vulkan13() {return(mVulkan13);}
+
+    const VkPhysicalDeviceFeatures& core() const {return(mFeatures2.features);}
+    const VkPhysicalDeviceVulkan11Features& vulkan11() const {return(mVulkan11);}
+    const VkPhysicalDeviceVulkan12Features& vulkan12() const {return(mVulkan12);}
+    const VkPhysicalDeviceVulkan13Features& vulkan13() const {return(mVulkan13);}
+
+    /// VK_EXT_memory_priority's feature. Only read by fromCreateInfo(), query() and link() leave it alone, so
+    /// enable it by passing a VkPhysicalDeviceMemoryPriorityFeaturesEXT through the create info's pNext chain.
+    VkBool32 memoryPriority() const {return(mMemoryPriority);}
+
+    ExtendedFeatureBits getExtendedBits() const;
+    void setExtendedBits(const ExtendedFeatureBits& aBits);
+
+    /// Name of extended feature aIndex, e.g. "Vulkan12.timelineSemaphore"
+    static const char* getExtendedFeatureName(size_t aIndex);
+
+    /// Links the structs a device of aApiVersion accepts into a chain for VkDeviceCreateInfo::pNext, ending in aTail.
+    /// Extensions needed for lowered features are appended to aExtensionsInOut if not already there.
+    /// Returns nullptr before Vulkan 1.1, where core() must be passed through pEnabledFeatures instead.
+    /// The chain points into this object, so it is valid until this object is modified or destroyed.
+    VkPhysicalDeviceFeatures2* link(uint32_t aApiVersion, std::vector<const char*>& aExtensionsInOut, void* aTail = nullptr);
+
+ protected:
+    /// Storage for one of the extension feature structs promoted into 1.1, 1.2 or 1.3. Each of them is a run of
+    /// VkBool32 after sType and pNext, so they share this layout.
+    struct _PromotedFeatures
+    {
+        VkStructureType sType;
+        void* pNext;
+        VkBool32 values[20];
+    };
+    static constexpr size_t sPromotedStructCount = 11;
+
+    void _unlink();
+
+    /// Links the 1.1-1.3 structs a device of aApiVersion accepts after mFeatures2, returns the pNext to continue from
+    void** _linkCore(uint32_t aApiVersion);
+
+    const VkBool32& _extendedFeature(size_t aIndex) const;
+    VkBool32& _extendedFeature(size_t aIndex){return(const_cast<VkBool32&>(static_cast<const VulkanFeatureChain*>(this)->_extendedFeature(aIndex)));}
+
+    VkPhysicalDeviceFeatures2 mFeatures2;
+    VkPhysicalDeviceVulkan11Features mVulkan11;
+    VkPhysicalDeviceVulkan12Features mVulkan12;
+    VkPhysicalDeviceVulkan13Features mVulkan13;
+    _PromotedFeatures mPromoted[sPromotedStructCount];
+    VkBool32 mMemoryPriority = VK_FALSE;
+};
+
 class VulkanLogicalDevice
 {
  public:
@@ -59,6 +190,25 @@ class VulkanLogicalDevice
     VkQueue getProtectedQueue() const {return(mProtectedQueue);}
     VkQueue getPresentationQueue() const {return(mPresentationQueue);}
 
+    /// Every queue created in family aFamily, in queue index order. Empty if the family was not requested.
+    const std::vector<VkQueue>& getFamilyQueues(uint32_t aFamily) const;
+    const std::map<uint32_t, std::vector<VkQueue>>& getAllQueues() const {return(mFamilyQueues);}
+
+    /// Extensions the device was created with
+    const PropertyNameIndex& getEnabledExtensions() const {return(mEnabledExtensions);}
+    bool isExtensionEnabled(std::string_view aName) const {return(mEnabledExtensions.contains(aName));}
+
+    /// Extensions aDevice was created with, for code which only holds the handle. Empty for devices not
+    /// created through VulkanPhysicalDevice::createLogicalDevice().
+    static PropertyNameIndex findEnabledExtensions(VkDevice aDevice);
+
+    /// Features the device was created with
+    const VulkanFeatureChain& getEnabledFeatures() const {return(mEnabledFeatures);}
+
+    /// Features aDevice was created with, for code which only holds the handle. Nothing is enabled for devices
+    /// not created through VulkanPhysicalDevice::createLogicalDevice().
+    static VulkanFeatureChain findEnabledFeatures(VkDevice aDevice);
+
     operator VkDevice() const {return(mHandle);}
 
  protected:
@@ -74,6 +224,58 @@ class VulkanLogicalDevice
     VkQueue mSparseBindingQueue = VK_NULL_HANDLE;
     VkQueue mProtectedQueue = VK_NULL_HANDLE;
     VkQueue mPresentationQueue = VK_NULL_HANDLE;
+
+    std::map<uint32_t, std::vector<VkQueue>> mFamilyQueues;
+    PropertyNameIndex mEnabledExtensions;
+    VulkanFeatureChain mEnabledFeatures;
+};
+
+/// Hands the queues of one family out to worker threads so that each can submit without sharing a queue.
+/// acquire() blocks until a queue is free. Queues must be given back with release(), or held through a Lease.
+class QueuePool
+{
+ public:
+    /// Releases its queue back to the pool when destroyed
+    class Lease
+    {
+     public:
+        Lease(){}
+        Lease(QueuePool& aPool) : _mPool(&aPool), _mQueue(aPool.acquire()) {}
+        ~Lease(){if(_mPool != nullptr && _mQueue != VK_NULL_HANDLE) _mPool->release(_mQueue);}
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        VkQueue handle() const {return(_mQueue);}
+        operator VkQueue() const {return(_mQueue);}
+
+     private:
+        QueuePool* _mPool = nullptr;
+        VkQueue _mQueue = VK_NULL_HANDLE;
+    };
+
+    QueuePool(const VulkanLogicalDevice& aDevice, uint32_t aFamily);
+
+    QueuePool(const QueuePool&) = delete;
+    QueuePool& operator=(const QueuePool&) = delete;
+
+    VkQueue acquire();
+
+    /// \returns VK_NULL_HANDLE if every queue is in use
+    VkQueue tryAcquire();
+    void release(VkQueue aQueue);
+
+    uint32_t getFamily() const {return(mFamily);}
+    size_t size() const {return(mQueueCount);}
+
+ protected:
+    uint32_t mFamily = 0;
+    size_t mQueueCount = 0;
+
+ private:
+    std::mutex _mMutex;
+    std::condition_variable _mCondition;
+    std::vector<VkQueue> _mFree;
 };
 
 struct SwapChainSupportInfo;
@@ -81,7 +283,34 @@ class VulkanPhysicalDevice
 {
  public:
    VulkanPhysicalDevice(){}
-   VulkanPhysicalDevice(VkPhysicalDevice aDevice);
+   /// \param aInstanceApiVersion VkApplicationInfo::apiVersion of the instance aDevice was enumerated from
+   VulkanPhysicalDevice(VkPhysicalDevice aDevice, uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION);
+
+   /// Process wide snapshot of aDevice, a physical device of aInstance. Properties, features, extensions and
+   /// queue families are queried the first time the pair is seen and reused by every later call. Safe to call
+   /// from multiple threads. Handles may be reused once their instance is destroyed, so call
+   /// clearCache(aInstance) before vkDestroyInstance(). aInstanceApiVersion is only used by the call that
+   /// creates the snapshot.
+   /// \throw std::runtime_error If aInstance is VK_NULL_HANDLE, since such a snapshot could never be dropped
+   static const VulkanPhysicalDevice& getCached(
+      VkPhysicalDevice aDevice,
+      VkInstance aInstance,
+      uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+   );
+
+   /// Copy of the cached snapshot when aInstance is known, otherwise a fresh query that is not cached
+   static VulkanPhysicalDevice getSnapshot(
+      VkPhysicalDevice aDevice,
+      VkInstance aInstance = VK_NULL_HANDLE,
+      uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+   );
+
+   /// Drop the snapshots cached for aInstance. References getCached() returned for them become dangling.
+   static void clearCache(VkInstance aInstance);
+
+   /// Drop every cached snapshot, e.g. after a driver update while the process is running. Every reference
+   /// previously returned by getCached() becomes dangling, so copy snapshots that must outlive this call.
+   static void clearCache();
 
    inline VkPhysicalDevice handle() const {return(mHandle);}
    inline bool isValid() const {return(mHandle != VK_NULL_HANDLE);}
@@ -96,7 +325,20 @@ class VulkanPhysicalDevice
       const std::vector<const char*>& aExtensions = std::vector<const char*>(),
       const VkPhysicalDeviceFeatures& aFeatures = {},
       VkSurfaceKHR aSurface = VK_NULL_HANDLE,
-      void* aDeviceCreateInfoPnext = nullptr
+      void* aDeviceCreateInfoPnext = nullptr,
+      const QueuePriorityMap& aQueuePriorities = QueuePriorityMap()
+   ) const;
+
+   /// Negotiates aRequired and aRequested against mFeatureChain, then creates the device with the resulting chain
+   /// ahead of aDeviceCreateInfoPnext. Throws if a required feature is unavailable, warns for requested ones.
+   VulkanLogicalDevice createLogicalDevice(
+      VkQueueFlags aQueues,
+      const std::vector<const char*>& aExtensions,
+      const VulkanFeatureChain& aRequired,
+      const VulkanFeatureChain& aRequested,
+      VkSurfaceKHR aSurface = VK_NULL_HANDLE,
+      void* aDeviceCreateInfoPnext = nullptr,
+      const QueuePriorityMap& aQueuePriorities = QueuePriorityMap()
    ) const;
 
    VulkanLogicalDevice createLogicalDevice(
@@ -116,25 +358,57 @@ class VulkanPhysicalDevice
    }
 
    VkPhysicalDeviceProperties mProperties;
+   // Version usable with this device, the lower of the instance's version and mProperties.apiVersion.
+   // Features, properties and device creation are all gated on this one.
+   uint32_t mApiVersion = VK_API_VERSION_1_0;
    VkPhysicalDeviceFeatures mFeatures;
+   // Features of the 1.1-1.3 structs and their extensions, core() matches mFeatures
+   VulkanFeatureChain mFeatureChain;
+   VkPhysicalDeviceMemoryProperties mMemoryProperties;
+   // Zero on devices older than Vulkan 1.1
+   uint32_t mSubgroupSize = 0;
    std::vector<QueueFamily> mQueueFamilies;
    std::vector<VkExtensionProperties> mAvailableExtensions;
+   // Hashed names of mAvailableExtensions
+   PropertyNameIndex mExtensionIndex;
+
+   bool hasExtension(std::string_view aName) const {return(mExtensionIndex.contains(aName));}
 
    opt::optional<uint32_t> mGraphicsIdx;
+   // First family with each capability, so compute and transfer usually share the graphics family.
+   // useDedicatedQueueFamilies() switches these to mDedicatedComputeIdx and mDedicatedTransferIdx.
    opt::optional<uint32_t> mComputeIdx;
    opt::optional<uint32_t> mTransferIdx;
+   // Compute family with the fewest graphics capabilities, and transfer family with the fewest graphics and compute ones
+   opt::optional<uint32_t> mDedicatedComputeIdx;
+   opt::optional<uint32_t> mDedicatedTransferIdx;
    opt::optional<uint32_t> mProtectedIdx;
    opt::optional<uint32_t> mSparseBindIdx;
 
    // Index of queue supporting graphics, compute, transfer, and presentation
    opt::optional<uint32_t> coreFeaturesIdx; 
 
+   // True when the device offers compute or transfer a family of its own, apart from graphics
+   bool hasDedicatedComputeFamily() const {return(mDedicatedComputeIdx && mDedicatedComputeIdx != mGraphicsIdx);}
+   bool hasDedicatedTransferFamily() const {
+      return(mDedicatedTransferIdx && mDedicatedTransferIdx != mGraphicsIdx && mDedicatedTransferIdx != mDedicatedComputeIdx);
+   }
+
+   /// Opt in to the dedicated families: mComputeIdx and mTransferIdx take mDedicatedComputeIdx and
+   /// mDedicatedTransferIdx, so later createLogicalDevice() calls create separate queues that overlap with
+   /// graphics. Work submitted there needs queue family ownership transfers for EXCLUSIVE resources.
+   void useDedicatedQueueFamilies();
+
    operator VkPhysicalDevice() const {return(mHandle);}
 
  protected:
    void _initExtensionProps();
+   void _initSubgroupProps();
    void _initQueueFamilies();
 
+   /// Index of the family with all of aRequired and the fewest of aAvoided
+   opt::optional<uint32_t> _selectQueueFamily(VkQueueFlags aRequired, VkQueueFlags aAvoided) const;
+
    VkPhysicalDevice mHandle = VK_NULL_HANDLE;
 };
 
@@ -189,7 +463,18 @@ class VulkanPhysicalDeviceEnumeration : public std::vector<VulkanPhysicalDevice>
     using base_vector = std::vector<VulkanPhysicalDevice>;
 
     VulkanPhysicalDeviceEnumeration(){}
-    VulkanPhysicalDeviceEnumeration(const std::vector<VkPhysicalDevice>& aDevices);
+
+    /// Snapshot of aDevices, physical devices of aInstance, taken from VulkanPhysicalDevice::getSnapshot()
+    VulkanPhysicalDeviceEnumeration(
+        const std::vector<VkPhysicalDevice>& aDevices,
+        VkInstance aInstance = VK_NULL_HANDLE,
+        uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+    );
+
+    /// Snapshot of every physical device of aInstance taken from VulkanPhysicalDevice::getSnapshot()
+    VulkanPhysicalDeviceEnumeration(VkInstance aInstance, uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION);
+
+    std::vector<VkPhysicalDevice> handles() const;
 
     using base_vector::operator[];
 };
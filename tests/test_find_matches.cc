@@ -0,0 +1,62 @@
+// Regression test for the std::vector<VkExtensionProperties> and std::vector<VkLayerProperties> forms of
+// find_extension_matches() and find_layer_matches(). They used to copy names out of a PropertyNameIndex
+// temporary that had already been destroyed. Build with AddressSanitizer to catch a regression reliably.
+#include "vkutils.h"
+#include <cstring>
+#include <iostream>
+
+static int sFailures = 0;
+
+static void check(bool aCondition, const char* aWhat){
+    if(aCondition) return;
+    std::cerr << "FAILED: " << aWhat << std::endl;
+    ++sFailures;
+}
+
+template<typename PropertyType>
+static std::vector<PropertyType> make_properties(const std::vector<const char*>& aNames, char (PropertyType::*aNameMember)[VK_MAX_EXTENSION_NAME_SIZE]){
+    std::vector<PropertyType> properties(aNames.size());
+    for(size_t i = 0; i < aNames.size(); ++i){
+        std::memset(&properties[i], 0, sizeof(PropertyType));
+        std::strncpy(properties[i].*aNameMember, aNames[i], VK_MAX_EXTENSION_NAME_SIZE - 1);
+    }
+    return(properties);
+}
+
+static void test_extension_matches(){
+    std::vector<VkExtensionProperties> available = make_properties(
+        {"VK_KHR_swapchain", "VK_KHR_maintenance1", "VK_EXT_memory_budget"}, &VkExtensionProperties::extensionName
+    );
+    std::vector<std::string> required = {"VK_KHR_swapchain"};
+    std::vector<std::string> requested = {"VK_EXT_not_available", "VK_EXT_memory_budget"};
+
+    std::vector<std::string> found;
+    std::unordered_map<std::string, bool> results;
+    vkutils::find_extension_matches(available, required, requested, found, &results);
+
+    check(found.size() == 2, "extension match count");
+    check(found.size() > 0 && found[0] == "VK_EXT_memory_budget", "requested extension copied intact");
+    check(found.size() > 1 && found[1] == "VK_KHR_swapchain", "required extension copied intact");
+    check(results["VK_KHR_swapchain"], "required extension reported found");
+    check(results["VK_EXT_memory_budget"], "requested extension reported found");
+    check(!results["VK_EXT_not_available"], "missing extension reported missing");
+}
+
+static void test_layer_matches(){
+    std::vector<VkLayerProperties> available = make_properties(
+        {"VK_LAYER_KHRONOS_validation"}, &VkLayerProperties::layerName
+    );
+    std::vector<std::string> required;
+    std::vector<std::string> requested = {"VK_LAYER_KHRONOS_validation"};
+
+    std::vector<std::string> found;
+    vkutils::find_layer_matches(available, required, requested, found, nullptr);
+
+    check(found.size() == 1 && found[0] == "VK_LAYER_KHRONOS_validation", "requested layer copied intact");
+}
+
+int main(){
+    test_extension_matches();
+    test_layer_matches();
+    return(sFailures == 0 ? 0 : 1);
+}
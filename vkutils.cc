@@ -6,8 +6,7 @@
 #include <iterator>
 #include <array>
 
-static bool confirm_queue_fam(VkPhysicalDevice aDevice, uint32_t aBitmask);
-static int score_physical_device(VkPhysicalDevice aDevice);
+static vkutils::PhysicalDeviceScore score_physical_device(const VulkanPhysicalDevice& aDevice);
 
 namespace vkutils{
 
@@ -18,22 +17,61 @@ std::vector<const char*> strings_to_cstrs(const std::vector<std::string>& aConta
    return(dst);
 }
 
-VkPhysicalDevice select_physical_device(const std::vector<VkPhysicalDevice>& aDevices){
-    int high_score = -1;
-    size_t max_index = 0;
-    std::vector<int> scores(aDevices.size());
-    for(size_t i = 0; i < aDevices.size(); ++i){
-        int score = score_physical_device(aDevices[i]);
-        if(score > high_score){
-            high_score = score;
-            max_index = i;
-        }
+std::vector<PhysicalDeviceScore> rank_physical_devices(
+    const std::vector<VkPhysicalDevice>& aDevices,
+    const DeviceScoreWeights& aWeights,
+    VkInstance aInstance,
+    uint32_t aInstanceApiVersion
+){
+    return(rank_physical_devices(VulkanPhysicalDeviceEnumeration(aDevices, aInstance, aInstanceApiVersion), aWeights));
+}
+
+std::vector<PhysicalDeviceScore> rank_physical_devices(const VulkanPhysicalDeviceEnumeration& aDevices, const DeviceScoreWeights& aWeights){
+    std::vector<PhysicalDeviceScore> scores;
+    scores.reserve(aDevices.size());
+    VkDeviceSize maxMemory = 0;
+    uint32_t maxInvocations = 0;
+    uint32_t maxSubgroup = 0;
+    for(const VulkanPhysicalDevice& device : aDevices){
+        scores.push_back(score_physical_device(device));
+        maxMemory = std::max(maxMemory, scores.back().deviceLocalBytes);
+        maxInvocations = std::max(maxInvocations, scores.back().maxComputeWorkGroupInvocations);
+        maxSubgroup = std::max(maxSubgroup, scores.back().subgroupSizeValue);
     }
-    if(high_score >= 0){
-        return(aDevices[max_index]);
-    }else{
-        return(VK_NULL_HANDLE);
+
+    for(PhysicalDeviceScore& score : scores){
+        score.deviceLocalMemory = (maxMemory == 0) ? 0.0f : static_cast<float>(static_cast<double>(score.deviceLocalBytes) / maxMemory);
+        score.computeInvocations = (maxInvocations == 0) ? 0.0f : static_cast<float>(score.maxComputeWorkGroupInvocations) / maxInvocations;
+        score.subgroupSize = (maxSubgroup == 0) ? 0.0f : static_cast<float>(score.subgroupSizeValue) / maxSubgroup;
+        if(!score.eligible) continue;
+
+        score.total =
+            aWeights.deviceType * score.deviceType +
+            aWeights.deviceLocalMemory * score.deviceLocalMemory +
+            aWeights.computeInvocations * score.computeInvocations +
+            aWeights.dedicatedTransfer * score.dedicatedTransfer +
+            aWeights.timestamps * score.timestamps +
+            aWeights.subgroupSize * score.subgroupSize;
     }
+
+    // Stable so that equally scored devices keep enumeration order
+    std::stable_sort(scores.begin(), scores.end(), [](const PhysicalDeviceScore& a, const PhysicalDeviceScore& b){return(a.total > b.total);});
+    return(scores);
+}
+
+VkPhysicalDevice select_physical_device(const VulkanPhysicalDeviceEnumeration& aDevices, const DeviceScoreWeights& aWeights){
+    std::vector<PhysicalDeviceScore> ranked = rank_physical_devices(aDevices, aWeights);
+    if(ranked.empty() || !ranked.front().eligible) return(VK_NULL_HANDLE);
+    return(ranked.front().device);
+}
+
+VkPhysicalDevice select_physical_device(
+    const std::vector<VkPhysicalDevice>& aDevices,
+    const DeviceScoreWeights& aWeights,
+    VkInstance aInstance,
+    uint32_t aInstanceApiVersion
+){
+    return(select_physical_device(VulkanPhysicalDeviceEnumeration(aDevices, aInstance, aInstanceApiVersion), aWeights));
 }
 
 VkFormat select_depth_format(const VkPhysicalDevice& aPhysDev, const VkFormat& aPreferred, bool aRequireStencil){
@@ -62,18 +100,9 @@ VkFormat select_depth_format(const VkPhysicalDevice& aPhysDev, const VkFormat& a
 }
 
 VkShaderModule load_shader_module(const VkDevice& aDevice, const std::string& aFilePath){
-    std::ifstream shaderFile(aFilePath, std::ios::in | std::ios::binary | std::ios::ate);
-    if(!shaderFile.is_open()){
-        perror(aFilePath.c_str());
-        throw std::runtime_error("Failed to open shader file" + aFilePath + "!");
-    }
-    size_t fileSize = static_cast<size_t>(shaderFile.tellg());
-    std::vector<uint8_t> byteCode(fileSize);
-    shaderFile.seekg(std::ios::beg);
-    shaderFile.read(reinterpret_cast<char*>(byteCode.data()), fileSize);
-    shaderFile.close();
-
-    VkShaderModule resultModule = create_shader_module(aDevice, byteCode, true);
+    MappedSpirvFile spirvFile(aFilePath);
+
+    VkShaderModule resultModule = create_shader_module(aDevice, spirvFile.words(), spirvFile.size(), true);
     if(resultModule == VK_NULL_HANDLE){
         std::cerr << "Failed to create shader module from '" << aFilePath << "'!" << std::endl;
     }
@@ -81,12 +110,16 @@ VkShaderModule load_shader_module(const VkDevice& aDevice, const std::string& aF
 }
 
 VkShaderModule create_shader_module(const VkDevice& aDevice, const std::vector<uint8_t>& aByteCode, bool silent){
+    return(create_shader_module(aDevice, reinterpret_cast<const uint32_t*>(aByteCode.data()), aByteCode.size(), silent));
+}
+
+VkShaderModule create_shader_module(const VkDevice& aDevice, const uint32_t* aCode, size_t aCodeSize, bool silent){
     VkShaderModuleCreateInfo createInfo;{
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         createInfo.pNext = nullptr;
         createInfo.flags = 0;
-        createInfo.codeSize = aByteCode.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(aByteCode.data());
+        createInfo.codeSize = aCodeSize;
+        createInfo.pCode = aCode;
     }
 
     VkShaderModule resultModule = VK_NULL_HANDLE;
@@ -96,6 +129,39 @@ VkShaderModule create_shader_module(const VkDevice& aDevice, const std::vector<u
     return(resultModule);
 }
 
+void find_feature_matches(
+    const VulkanFeatureChain& aAvailable,
+    const VulkanFeatureChain& aRequired,
+    const VulkanFeatureChain& aRequested,
+    VulkanFeatureChain& aFeaturesOut
+){
+    VkPhysicalDeviceFeatures coreFeatures = {};
+    find_feature_matches(aAvailable.core(), aRequired.core(), aRequested.core(), coreFeatures);
+
+    const VulkanFeatureChain::ExtendedFeatureBits available = aAvailable.getExtendedBits();
+    const VulkanFeatureChain::ExtendedFeatureBits required = aRequired.getExtendedBits();
+    const VulkanFeatureChain::ExtendedFeatureBits requested = aRequested.getExtendedBits();
+
+    const VulkanFeatureChain::ExtendedFeatureBits missingRequired = required & ~available;
+    if(missingRequired.any()){
+        for(size_t i = 0; i < VulkanFeatureChain::sExtendedFeatureCount; ++i){
+            if(missingRequired[i]){
+                throw std::runtime_error("Error: Feature '" + std::string(VulkanFeatureChain::getExtendedFeatureName(i)) + "' is required, but not available on the given device!");
+            }
+        }
+    }
+
+    const VulkanFeatureChain::ExtendedFeatureBits missingRequested = requested & ~available;
+    for(size_t i = 0; missingRequested.any() && i < VulkanFeatureChain::sExtendedFeatureCount; ++i){
+        if(missingRequested[i]){
+            std::cerr << "Warning: Feature '" << VulkanFeatureChain::getExtendedFeatureName(i) << "' is requested, but not available on the given device!" << std::endl;
+        }
+    }
+
+    aFeaturesOut = VulkanFeatureChain(coreFeatures);
+    aFeaturesOut.setExtendedBits(required | (requested & available));
+}
+
 uint32_t total_descriptor_count(const std::vector<VkDescriptorPoolSize>& aPoolSizes){
     uint32_t sum = 0;
     for(const VkDescriptorPoolSize& size : aPoolSizes){
@@ -135,19 +201,181 @@ std::pair<std::vector<VkSpecializationMapEntry>, std::vector<uint8_t>> concat_sp
     return(std::make_pair(std::move(entries), std::move(data)));
 }
 
-VkCommandBuffer QueueClosure::beginOneSubmitCommands(VkCommandPool aCommandPool){
-    // Create a one off command pool internally
-    if(aCommandPool == VK_NULL_HANDLE){
-        _mCmdPoolInternal = true;
-        VkCommandPoolCreateInfo poolCreate = {};
-        poolCreate.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolCreate.queueFamilyIndex = mFamilyIdx;
-        poolCreate.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-        VkResult poolCreateResult = vkCreateCommandPool(_mDevicePair.device, &poolCreate, nullptr, &_mCommandPool);
-        assert(poolCreateResult == VK_SUCCESS);
-        aCommandPool = _mCommandPool;
+TimelineSemaphore::TimelineSemaphore(VkDevice aDevice, uint64_t aInitialValue)
+: mDevice(aDevice), _mLastSubmitted(aInitialValue), _mCompletedCache(aInitialValue)
+{
+    VkSemaphoreTypeCreateInfo typeInfo = {};
+    {
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.pNext = nullptr;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = aInitialValue;
     }
-    
+
+    VkSemaphoreCreateInfo createInfo = {};
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        createInfo.pNext = &typeInfo;
+        createInfo.flags = 0;
+    }
+
+    VkResult createResult = vkCreateSemaphore(mDevice, &createInfo, nullptr, &mSemaphore);
+    if(createResult != VK_SUCCESS){
+        throw std::runtime_error("Failed to create timeline semaphore! (" + std::string(vk_result_str(createResult)) + ")");
+    }
+}
+
+uint64_t TimelineSemaphore::getCompletedValue() const{
+    uint64_t value = 0;
+    ASSERT_VK_SUCCESS(vkGetSemaphoreCounterValue(mDevice, mSemaphore, &value));
+    _raiseCompletedCache(value);
+    return(value);
+}
+
+void TimelineSemaphore::_raiseCompletedCache(uint64_t aValue) const{
+    uint64_t cached = _mCompletedCache.load(std::memory_order_relaxed);
+    while(cached < aValue && !_mCompletedCache.compare_exchange_weak(cached, aValue, std::memory_order_release, std::memory_order_relaxed));
+}
+
+bool TimelineSemaphore::isReached(uint64_t aValue) const{
+    if(_mCompletedCache.load(std::memory_order_acquire) >= aValue) return(true);
+    return(getCompletedValue() >= aValue);
+}
+
+VkResult TimelineSemaphore::wait(uint64_t aValue, uint64_t aTimeoutNs) const{
+    if(_mCompletedCache.load(std::memory_order_acquire) >= aValue) return(VK_SUCCESS);
+
+    VkSemaphoreWaitInfo waitInfo = {};
+    {
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.pNext = nullptr;
+        waitInfo.flags = 0;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &mSemaphore;
+        waitInfo.pValues = &aValue;
+    }
+    VkResult waitResult = vkWaitSemaphores(mDevice, &waitInfo, aTimeoutNs);
+    if(waitResult == VK_SUCCESS) _raiseCompletedCache(aValue);
+    return(waitResult);
+}
+
+VkResult TimelineSemaphore::signal(uint64_t aValue){
+    std::lock_guard<std::mutex> lock(_mSubmitMutex);
+    if(aValue <= _mLastSubmitted.load(std::memory_order_relaxed)){
+        throw std::runtime_error("Timeline semaphore values must increase monotonically!");
+    }
+
+    VkSemaphoreSignalInfo signalInfo = {};
+    {
+        signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+        signalInfo.pNext = nullptr;
+        signalInfo.semaphore = mSemaphore;
+        signalInfo.value = aValue;
+    }
+    VkResult signalResult = vkSignalSemaphore(mDevice, &signalInfo);
+    if(signalResult == VK_SUCCESS) _mLastSubmitted.store(aValue, std::memory_order_release);
+    return(signalResult);
+}
+
+void TimelineSemaphore::destroy(){
+    if(mSemaphore != VK_NULL_HANDLE){
+        vkDestroySemaphore(mDevice, mSemaphore, nullptr);
+        mSemaphore = VK_NULL_HANDLE;
+    }
+}
+
+bool SubmitHandle::poll() const{
+    return(_mState == nullptr || _mState->check(0) == VK_SUCCESS);
+}
+
+VkResult SubmitHandle::wait(uint64_t aTimeoutNs) const{
+    return(_mState == nullptr ? VK_SUCCESS : _mState->check(aTimeoutNs));
+}
+
+void SubmitHandle::then(std::function<void()> aContinuation){
+    if(_mState != nullptr){
+        std::lock_guard<std::mutex> lock(_mState->mutex);
+        if(!_mState->complete){
+            _mState->continuations.push_back(std::move(aContinuation));
+            return;
+        }
+    }
+    aContinuation();
+}
+
+VkSemaphore SubmitHandle::getTimeline() const{
+    if(_mState == nullptr) return(VK_NULL_HANDLE);
+    std::lock_guard<std::mutex> lock(_mState->mutex);
+    return(_mState->submitted ? _mState->timeline : VK_NULL_HANDLE);
+}
+
+uint64_t SubmitHandle::getTimelineValue() const{
+    if(_mState == nullptr) return(0);
+    std::lock_guard<std::mutex> lock(_mState->mutex);
+    return(_mState->submitted ? _mState->timelineValue : 0);
+}
+
+VkResult SubmitHandle::_State::check(uint64_t aTimeoutNs, bool aBlockOnLock){
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    if(aBlockOnLock){
+        lock.lock();
+    }else if(!lock.try_lock()){
+        return(VK_NOT_READY);
+    }
+    if(complete) return(status);
+    if(!submitted) return(VK_NOT_READY);
+
+    VkResult result = VK_SUCCESS;
+    if(fence != VK_NULL_HANDLE){
+        result = (aTimeoutNs == 0) ? vkGetFenceStatus(device, fence) : vkWaitForFences(device, 1, &fence, VK_TRUE, aTimeoutNs);
+    }else if(aTimeoutNs == 0){
+        uint64_t counterValue = 0;
+        result = vkGetSemaphoreCounterValue(device, timeline, &counterValue);
+        if(result == VK_SUCCESS && counterValue < timelineValue) result = VK_NOT_READY;
+    }else{
+        VkSemaphoreWaitInfo waitInfo = {};
+        {
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &timeline;
+            waitInfo.pValues = &timelineValue;
+        }
+        result = vkWaitSemaphores(device, &waitInfo, aTimeoutNs);
+    }
+    if(result != VK_SUCCESS) return(result);
+
+    _resolve(lock);
+    return(VK_SUCCESS);
+}
+
+bool SubmitHandle::_State::resolveReached(uint64_t aCompletedValue){
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if(!lock.owns_lock()) return(false);
+    if(complete) return(true);
+    if(!submitted || timelineValue > aCompletedValue) return(false);
+
+    _resolve(lock);
+    return(true);
+}
+
+void SubmitHandle::_State::_resolve(std::unique_lock<std::mutex>& aLock){
+    // The fence is recycled once complete, so drop it before anyone else can observe the state
+    complete = true;
+    fence = VK_NULL_HANDLE;
+    std::vector<std::function<void()>> ready;
+    ready.swap(continuations);
+    aLock.unlock();
+
+    for(std::function<void()>& continuation : ready){
+        continuation();
+    }
+}
+
+QueueClosure::QueueClosure(const VulkanDeviceHandlePair& aDevicePair, uint32_t aFamily, VkQueue aQueue)
+: mQueue(aQueue), mFamilyIdx(aFamily), _mDevicePair(aDevicePair), _mSyncQueue(SynchronizedQueue::get(aQueue))
+{}
+
+VkCommandBuffer QueueClosure::beginOneSubmitCommands(VkCommandPool aCommandPool){
     VkCommandBufferAllocateInfo allocInfo = {};
     {
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -163,7 +391,22 @@ VkCommandBuffer QueueClosure::beginOneSubmitCommands(VkCommandPool aCommandPool)
     }
 
     VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
-    ASSERT_VK_SUCCESS(vkAllocateCommandBuffers(_mDevicePair.device, &allocInfo, &cmdBuffer) );
+    if(aCommandPool == VK_NULL_HANDLE){
+        // Take a command buffer from this thread's transient pool, reusing one whose submission has completed
+        _CommandRing& ring = *_getThreadRing(true);
+        _recycleRing(ring);
+        if(!ring.freeCmdBuffers.empty()){
+            cmdBuffer = ring.freeCmdBuffers.back();
+            ring.freeCmdBuffers.pop_back();
+        }else{
+            allocInfo.commandPool = ring.pool;
+            ASSERT_VK_SUCCESS(vkAllocateCommandBuffers(_mDevicePair.device, &allocInfo, &cmdBuffer) );
+        }
+        ring.recording.push_back(cmdBuffer);
+    }else{
+        ASSERT_VK_SUCCESS(vkAllocateCommandBuffers(_mDevicePair.device, &allocInfo, &cmdBuffer) );
+    }
+
     ASSERT_VK_SUCCESS(vkBeginCommandBuffer(cmdBuffer, &beginInfo) );
 
     return(cmdBuffer);
@@ -178,33 +421,329 @@ VkResult QueueClosure::finishOneSubmitCommands(
     const std::vector<VkSemaphore>& aWaitSemaphores,
     const std::vector<VkSemaphore>& aSignalSemaphores,
     VkFence aFence,
-    bool aShouldWait
+    bool aShouldWait,
+    const std::vector<uint64_t>& aWaitValues
+){
+    std::shared_ptr<SubmitHandle::_State> state;
+    VkResult submitResult = _submitOne(aCmdBuffer, aWaitSemaphores, aSignalSemaphores, aWaitValues, aFence, state);
+
+    // Wait on this submission alone rather than draining the whole queue
+    if(submitResult == VK_SUCCESS && aShouldWait && aFence == VK_NULL_HANDLE) submitResult = SubmitHandle(state).wait();
+    return(submitResult);
+}
+
+SubmitHandle QueueClosure::finishOneSubmitCommandsAsync(
+    const VkCommandBuffer& aCmdBuffer,
+    const std::vector<VkSemaphore>& aWaitSemaphores,
+    const std::vector<VkSemaphore>& aSignalSemaphores,
+    const std::vector<uint64_t>& aWaitValues
+){
+    std::shared_ptr<SubmitHandle::_State> state;
+    VkResult submitResult = _submitOne(aCmdBuffer, aWaitSemaphores, aSignalSemaphores, aWaitValues, VK_NULL_HANDLE, state);
+    if(submitResult != VK_SUCCESS){
+        throw std::runtime_error("Failed to submit one-shot commands! (" + std::string(vk_result_str(submitResult)) + ")");
+    }
+    return(SubmitHandle(state));
+}
+
+VkResult QueueClosure::_submitOne(
+    const VkCommandBuffer& aCmdBuffer,
+    const std::vector<VkSemaphore>& aWaitSemaphores,
+    const std::vector<VkSemaphore>& aSignalSemaphores,
+    const std::vector<uint64_t>& aWaitValues,
+    VkFence aFence,
+    std::shared_ptr<SubmitHandle::_State>& aStateOut
 ){
     ASSERT_VK_SUCCESS(vkEndCommandBuffer(aCmdBuffer));
+
+    std::vector<VkPipelineStageFlags> waitStages(aWaitSemaphores.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    std::vector<uint64_t> waitValues(aWaitValues);
+    waitValues.resize(aWaitSemaphores.size(), 0);
     
     VkSubmitInfo submission = sSingleSubmitTemplate;
     submission.commandBufferCount = 1;
     submission.pCommandBuffers = &aCmdBuffer;
     submission.waitSemaphoreCount = static_cast<uint32_t>(aWaitSemaphores.size());
     submission.pWaitSemaphores = aWaitSemaphores.data();
+    submission.pWaitDstStageMask = waitStages.data();
     submission.signalSemaphoreCount = static_cast<uint32_t>(aSignalSemaphores.size());
     submission.pSignalSemaphores = aSignalSemaphores.data();
-    
-    VkResult submitResult = vkQueueSubmit(mQueue, 1, &submission, aFence);
-    if(submitResult == VK_SUCCESS && aShouldWait && aFence == VK_NULL_HANDLE) vkQueueWaitIdle(mQueue);
-    _cleanupSubmit(aCmdBuffer);
+
+    _CommandRing& ring = *_getThreadRing(true);
+    _InFlightCommands tracked;
+    if(_takeRecording(ring, aCmdBuffer)) tracked.cmdBuffer = aCmdBuffer;
+
+    // The timeline lock is held until the submit reaches the queue so values are signaled in order
+    std::unique_lock<std::mutex> timelineLock;
+    uint64_t timelineValue = 0;
+    _TimelineSubmit timelineSubmit;
+    if(_mTimeline != nullptr){
+        timelineLock = std::unique_lock<std::mutex>(_mTimeline->_mSubmitMutex);
+        timelineValue = _mTimeline->getLastSubmittedValue() + 1;
+    }
+    _appendTimelineValues(
+        submission,
+        aWaitValues.empty() ? nullptr : waitValues.data(),
+        (_mTimeline != nullptr) ? &timelineValue : nullptr,
+        timelineSubmit
+    );
+
+    // Command buffers from the internal ring are tracked so they can be recycled once complete. Their completion
+    // is always observed through the timeline value or a pooled fence, never through a caller supplied fence, which
+    // the caller may reset or destroy as soon as it has signaled.
+    if(_mTimeline != nullptr){
+        tracked.state = std::make_shared<SubmitHandle::_State>(_mDevicePair.device, _mTimeline->handle(), timelineValue);
+    }else{
+        tracked.ownedFence = _acquireFence(ring);
+        tracked.state = std::make_shared<SubmitHandle::_State>(_mDevicePair.device, tracked.ownedFence);
+    }
+
+    // With a pooled fence, the caller's fence is signaled by an empty submit right after, which completes
+    // once every earlier submission on the queue has
+    VkResult submitResult = _mSyncQueue->submit(submission, (tracked.ownedFence != VK_NULL_HANDLE) ? tracked.ownedFence : aFence);
+    if(submitResult == VK_SUCCESS && _mTimeline != nullptr){
+        _mTimeline->_mLastSubmitted.store(timelineValue, std::memory_order_release);
+        _mLastTimelineValue.store(timelineValue, std::memory_order_release);
+    }
+    if(timelineLock.owns_lock()) timelineLock.unlock();
+
+    if(submitResult == VK_SUCCESS){
+        if(tracked.cmdBuffer != VK_NULL_HANDLE || tracked.ownedFence != VK_NULL_HANDLE) ring.inFlight.push_back(tracked);
+        aStateOut = tracked.state;
+        if(aFence != VK_NULL_HANDLE && tracked.ownedFence != VK_NULL_HANDLE) submitResult = _mSyncQueue->submit(0, nullptr, aFence);
+    }else{
+        // Nothing reached the queue, so everything can be reused right away
+        if(tracked.cmdBuffer != VK_NULL_HANDLE){
+            ASSERT_VK_SUCCESS(vkResetCommandBuffer(tracked.cmdBuffer, 0));
+            ring.freeCmdBuffers.push_back(tracked.cmdBuffer);
+        }
+        if(tracked.ownedFence != VK_NULL_HANDLE) ring.freeFences.push_back(tracked.ownedFence);
+    }
+
     return(submitResult);
 }
 
-void QueueClosure::_cleanupSubmit(const VkCommandBuffer& aCmdBuffer){
-    if(aCmdBuffer != VK_NULL_HANDLE && _mCmdPoolInternal){
-        vkFreeCommandBuffers(_mDevicePair.device, _mCommandPool, 1, &aCmdBuffer);
+void QueueClosure::recycleCompletedCommands(){
+    _CommandRing* ring = _getThreadRing(false);
+    if(ring != nullptr) _recycleRing(*ring);
+}
+
+QueueClosure::_CommandRing* QueueClosure::_getThreadRing(bool aCreateIfMissing){
+    std::lock_guard<std::mutex> lock(_mRingMutex);
+    auto finder = _mCommandRings.find(std::this_thread::get_id());
+    if(finder != _mCommandRings.end()) return(finder->second.get());
+    if(!aCreateIfMissing) return(nullptr);
+
+    std::unique_ptr<_CommandRing> ring = std::make_unique<_CommandRing>();
+    VkCommandPoolCreateInfo poolCreate = {};
+    poolCreate.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolCreate.queueFamilyIndex = mFamilyIdx;
+    poolCreate.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VkResult poolCreateResult = vkCreateCommandPool(_mDevicePair.device, &poolCreate, nullptr, &ring->pool);
+    if(poolCreateResult != VK_SUCCESS){
+        throw std::runtime_error("Failed to create transient command pool! (" + std::string(vk_result_str(poolCreateResult)) + ")");
     }
-    if(_mCommandPool != VK_NULL_HANDLE){
-        vkDestroyCommandPool(_mDevicePair.device, _mCommandPool, nullptr);
-        _mCommandPool = VK_NULL_HANDLE;
+
+    _CommandRing* result = ring.get();
+    _mCommandRings.emplace(std::this_thread::get_id(), std::move(ring));
+    return(result);
+}
+
+VkFence QueueClosure::_acquireFence(_CommandRing& aRing){
+    VkFence fence = VK_NULL_HANDLE;
+    if(!aRing.freeFences.empty()){
+        fence = aRing.freeFences.back();
+        aRing.freeFences.pop_back();
+        return(fence);
+    }
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    ASSERT_VK_SUCCESS(vkCreateFence(_mDevicePair.device, &fenceInfo, nullptr, &fence));
+    return(fence);
+}
+
+void QueueClosure::_appendTimelineValues(VkSubmitInfo& aSubmission, const uint64_t* aWaitValues, const uint64_t* aSignalValue, _TimelineSubmit& aStorage) const{
+    if(aWaitValues == nullptr && aSignalValue == nullptr) return;
+
+    // Once the struct is chained both value arrays must match their semaphore counts. Binary semaphores
+    // ignore their entries.
+    aStorage.signalSemaphores.assign(aSubmission.pSignalSemaphores, aSubmission.pSignalSemaphores + aSubmission.signalSemaphoreCount);
+    aStorage.signalValues.assign(aStorage.signalSemaphores.size(), 0);
+    if(aSignalValue != nullptr){
+        aStorage.signalSemaphores.push_back(_mTimeline->handle());
+        aStorage.signalValues.push_back(*aSignalValue);
+    }
+    if(aWaitValues != nullptr){
+        aStorage.waitValues.assign(aWaitValues, aWaitValues + aSubmission.waitSemaphoreCount);
+    }else{
+        aStorage.waitValues.assign(aSubmission.waitSemaphoreCount, 0);
     }
-    _mCmdPoolInternal = false;
+
+    aStorage.info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    aStorage.info.pNext = aSubmission.pNext;
+    aStorage.info.waitSemaphoreValueCount = static_cast<uint32_t>(aStorage.waitValues.size());
+    aStorage.info.pWaitSemaphoreValues = aStorage.waitValues.data();
+    aStorage.info.signalSemaphoreValueCount = static_cast<uint32_t>(aStorage.signalValues.size());
+    aStorage.info.pSignalSemaphoreValues = aStorage.signalValues.data();
+
+    aSubmission.pNext = &aStorage.info;
+    aSubmission.signalSemaphoreCount = static_cast<uint32_t>(aStorage.signalSemaphores.size());
+    aSubmission.pSignalSemaphores = aStorage.signalSemaphores.data();
+}
+
+std::shared_ptr<SubmitHandle::_State> QueueClosure::_createSubmitState(){
+    // The fence or timeline value backing the state is chosen when the batch is submitted
+    std::shared_ptr<SubmitHandle::_State> state = std::make_shared<SubmitHandle::_State>(_mDevicePair.device, VkFence(VK_NULL_HANDLE));
+    state->submitted = false;
+    return(state);
+}
+
+VkResult QueueClosure::_submitBatch(
+    const std::vector<VkSubmitInfo>& aSubmissions,
+    const std::vector<const uint64_t*>& aWaitValues,
+    const std::vector<VkCommandBuffer>& aCmdBuffers,
+    const std::shared_ptr<SubmitHandle::_State>& aState
+){
+    _CommandRing& ring = *_getThreadRing(true);
+    std::vector<VkSubmitInfo> submissions(aSubmissions);
+
+    std::unique_lock<std::mutex> timelineLock;
+    uint64_t timelineValue = 0;
+    VkFence batchFence = VK_NULL_HANDLE;
+    if(_mTimeline != nullptr){
+        timelineLock = std::unique_lock<std::mutex>(_mTimeline->_mSubmitMutex);
+        timelineValue = _mTimeline->getLastSubmittedValue() + 1;
+    }else{
+        batchFence = _acquireFence(ring);
+    }
+
+    // Only the last submission signals the attached timeline. Sized up front, the submit infos point into it.
+    std::vector<_TimelineSubmit> timelineSubmits(submissions.size());
+    for(size_t i = 0; i < submissions.size(); ++i){
+        bool signalsTimeline = _mTimeline != nullptr && i + 1 == submissions.size();
+        _appendTimelineValues(submissions[i], aWaitValues[i], signalsTimeline ? &timelineValue : nullptr, timelineSubmits[i]);
+    }
+
+    VkResult submitResult = _mSyncQueue->submit(static_cast<uint32_t>(submissions.size()), submissions.data(), batchFence);
+    if(submitResult == VK_SUCCESS && _mTimeline != nullptr){
+        _mTimeline->_mLastSubmitted.store(timelineValue, std::memory_order_release);
+        _mLastTimelineValue.store(timelineValue, std::memory_order_release);
+    }
+    if(timelineLock.owns_lock()) timelineLock.unlock();
+
+    if(submitResult == VK_SUCCESS){
+        {
+            std::lock_guard<std::mutex> lock(aState->mutex);
+            aState->fence = batchFence;
+            aState->timeline = (_mTimeline != nullptr) ? _mTimeline->handle() : VK_NULL_HANDLE;
+            aState->timelineValue = timelineValue;
+            aState->submitted = true;
+        }
+
+        // Every buffer in the batch retires through the shared state, and the last entry returns the fence
+        for(size_t i = 0; i < aCmdBuffers.size(); ++i){
+            _InFlightCommands tracked;
+            if(_takeRecording(ring, aCmdBuffers[i])) tracked.cmdBuffer = aCmdBuffers[i];
+            tracked.ownedFence = (i + 1 == aCmdBuffers.size()) ? batchFence : VK_NULL_HANDLE;
+            tracked.state = aState;
+            if(tracked.cmdBuffer != VK_NULL_HANDLE || tracked.ownedFence != VK_NULL_HANDLE) ring.inFlight.push_back(tracked);
+        }
+        return(submitResult);
+    }
+
+    // Nothing reached the queue. Recycle everything and resolve the batch's handles with the failure.
+    for(const VkCommandBuffer& cmdBuffer : aCmdBuffers){
+        if(_takeRecording(ring, cmdBuffer)){
+            ASSERT_VK_SUCCESS(vkResetCommandBuffer(cmdBuffer, 0));
+            ring.freeCmdBuffers.push_back(cmdBuffer);
+        }
+    }
+    if(batchFence != VK_NULL_HANDLE) ring.freeFences.push_back(batchFence);
+
+    // Queued continuations still run, as they would after a successful submit, and see the error through wait()
+    std::unique_lock<std::mutex> lock(aState->mutex);
+    aState->status = submitResult;
+    aState->_resolve(lock);
+    return(submitResult);
+}
+
+bool QueueClosure::_takeRecording(_CommandRing& aRing, VkCommandBuffer aCmdBuffer){
+    std::vector<VkCommandBuffer>::iterator recordIter = std::find(aRing.recording.begin(), aRing.recording.end(), aCmdBuffer);
+    if(recordIter == aRing.recording.end()) return(false);
+    aRing.recording.erase(recordIter);
+    return(true);
+}
+
+bool QueueClosure::_isRetired(_InFlightCommands& aSubmitted, uint64_t aTimelineCompleted){
+    // Submissions on the attached timeline resolve against the counter value read once per recycling pass
+    bool onTimeline = _mTimeline != nullptr && aSubmitted.state->timeline == _mTimeline->handle();
+    if(onTimeline) return(aSubmitted.state->resolveReached(aTimelineCompleted));
+
+    // A handle blocked on this submission holds its state, in which case the entry is retired on a later pass
+    return(aSubmitted.state->check(0, false) == VK_SUCCESS);
+}
+
+void QueueClosure::_recycleRing(_CommandRing& aRing){
+    if(aRing.inFlight.empty()) return;
+    uint64_t timelineCompleted = (_mTimeline != nullptr) ? _mTimeline->getCompletedValue() : 0;
+
+    std::deque<_InFlightCommands>::iterator iter = aRing.inFlight.begin();
+    while(iter != aRing.inFlight.end()){
+        if(!_isRetired(*iter, timelineCompleted)){
+            ++iter;
+            continue;
+        }
+
+        if(iter->cmdBuffer != VK_NULL_HANDLE){
+            ASSERT_VK_SUCCESS(vkResetCommandBuffer(iter->cmdBuffer, 0));
+            aRing.freeCmdBuffers.push_back(iter->cmdBuffer);
+        }
+        if(iter->ownedFence != VK_NULL_HANDLE){
+            ASSERT_VK_SUCCESS(vkResetFences(_mDevicePair.device, 1, &iter->ownedFence));
+            aRing.freeFences.push_back(iter->ownedFence);
+        }
+        iter = aRing.inFlight.erase(iter);
+    }
+}
+
+void QueueClosure::releaseThreadCommands(){
+    std::unique_ptr<_CommandRing> ring;
+    {
+        std::lock_guard<std::mutex> lock(_mRingMutex);
+        auto finder = _mCommandRings.find(std::this_thread::get_id());
+        if(finder == _mCommandRings.end()) return;
+        if(!finder->second->recording.empty()){
+            throw std::runtime_error("Released the thread's command buffers while one is still being recorded!");
+        }
+        ring = std::move(finder->second);
+        _mCommandRings.erase(finder);
+    }
+    _destroyRing(*ring, std::numeric_limits<uint64_t>::max());
+}
+
+void QueueClosure::_destroyRing(_CommandRing& aRing, uint64_t aTimeoutNs){
+    for(VkFence fence : aRing.freeFences){
+        vkDestroyFence(_mDevicePair.device, fence, nullptr);
+    }
+    for(const _InFlightCommands& submitted : aRing.inFlight){
+        // Resolve outstanding handles before their fence goes away
+        submitted.state->check(aTimeoutNs);
+        if(submitted.ownedFence != VK_NULL_HANDLE) vkDestroyFence(_mDevicePair.device, submitted.ownedFence, nullptr);
+    }
+    // Destroying the pool frees every command buffer allocated from it
+    vkDestroyCommandPool(_mDevicePair.device, aRing.pool, nullptr);
+}
+
+void QueueClosure::_releaseCommandRings(){
+    std::lock_guard<std::mutex> lock(_mRingMutex);
+
+    // Drain the queue once rather than waiting on every ring's submissions in turn
+    bool anyInFlight = std::any_of(_mCommandRings.begin(), _mCommandRings.end(), [](const auto& entry){return(!entry.second->inFlight.empty());});
+    if(anyInFlight) _mSyncQueue->waitIdle();
+
+    for(auto& entry : _mCommandRings) _destroyRing(*entry.second, 0);
+    _mCommandRings.clear();
 }
 
 const char* vk_result_str(VkResult r){
@@ -296,61 +835,7 @@ void boolean_op_phys_device_features(
     VkPhysicalDeviceFeatures& aFeaturesOut,
     const std::function<VkBool32(VkBool32, VkBool32, const char*)>& aBinaryFunc
 ){
-    aFeaturesOut.robustBufferAccess = aBinaryFunc(a.robustBufferAccess, b.robustBufferAccess, "robustBufferAccess");
-    aFeaturesOut.fullDrawIndexUint32 = aBinaryFunc(a.fullDrawIndexUint32, b.fullDrawIndexUint32, "fullDrawIndexUint32");
-    aFeaturesOut.imageCubeArray = aBinaryFunc(a.imageCubeArray, b.imageCubeArray, "imageCubeArray");
-    aFeaturesOut.independentBlend = aBinaryFunc(a.independentBlend, b.independentBlend, "independentBlend");
-    aFeaturesOut.geometryShader = aBinaryFunc(a.geometryShader, b.geometryShader, "geometryShader");
-    aFeaturesOut.tessellationShader = aBinaryFunc(a.tessellationShader, b.tessellationShader, "tessellationShader");
-    aFeaturesOut.sampleRateShading = aBinaryFunc(a.sampleRateShading, b.sampleRateShading, "sampleRateShading");
-    aFeaturesOut.dualSrcBlend = aBinaryFunc(a.dualSrcBlend, b.dualSrcBlend, "dualSrcBlend");
-    aFeaturesOut.logicOp = aBinaryFunc(a.logicOp, b.logicOp, "logicOp");
-    aFeaturesOut.multiDrawIndirect = aBinaryFunc(a.multiDrawIndirect, b.multiDrawIndirect, "multiDrawIndirect");
-    aFeaturesOut.drawIndirectFirstInstance = aBinaryFunc(a.drawIndirectFirstInstance, b.drawIndirectFirstInstance, "drawIndirectFirstInstance");
-    aFeaturesOut.depthClamp = aBinaryFunc(a.depthClamp, b.depthClamp, "depthClamp");
-    aFeaturesOut.depthBiasClamp = aBinaryFunc(a.depthBiasClamp, b.depthBiasClamp, "depthBiasClamp");
-    aFeaturesOut.fillModeNonSolid = aBinaryFunc(a.fillModeNonSolid, b.fillModeNonSolid, "fillModeNonSolid");
-    aFeaturesOut.depthBounds = aBinaryFunc(a.depthBounds, b.depthBounds, "depthBounds");
-    aFeaturesOut.wideLines = aBinaryFunc(a.wideLines, b.wideLines, "wideLines");
-    aFeaturesOut.largePoints = aBinaryFunc(a.largePoints, b.largePoints, "largePoints");
-    aFeaturesOut.alphaToOne = aBinaryFunc(a.alphaToOne, b.alphaToOne, "alphaToOne");
-    aFeaturesOut.multiViewport = aBinaryFunc(a.multiViewport, b.multiViewport, "multiViewport");
-    aFeaturesOut.samplerAnisotropy = aBinaryFunc(a.samplerAnisotropy, b.samplerAnisotropy, "samplerAnisotropy");
-    aFeaturesOut.textureCompressionETC2 = aBinaryFunc(a.textureCompressionETC2, b.textureCompressionETC2, "textureCompressionETC2");
-    aFeaturesOut.textureCompressionASTC_LDR = aBinaryFunc(a.textureCompressionASTC_LDR, b.textureCompressionASTC_LDR, "textureCompressionASTC_LDR");
-    aFeaturesOut.textureCompressionBC = aBinaryFunc(a.textureCompressionBC, b.textureCompressionBC, "textureCompressionBC");
-    aFeaturesOut.occlusionQueryPrecise = aBinaryFunc(a.occlusionQueryPrecise, b.occlusionQueryPrecise, "occlusionQueryPrecise");
-    aFeaturesOut.pipelineStatisticsQuery = aBinaryFunc(a.pipelineStatisticsQuery, b.pipelineStatisticsQuery, "pipelineStatisticsQuery");
-    aFeaturesOut.vertexPipelineStoresAndAtomics = aBinaryFunc(a.vertexPipelineStoresAndAtomics, b.vertexPipelineStoresAndAtomics, "vertexPipelineStoresAndAtomics");
-    aFeaturesOut.fragmentStoresAndAtomics = aBinaryFunc(a.fragmentStoresAndAtomics, b.fragmentStoresAndAtomics, "fragmentStoresAndAtomics");
-    aFeaturesOut.shaderTessellationAndGeometryPointSize = aBinaryFunc(a.shaderTessellationAndGeometryPointSize, b.shaderTessellationAndGeometryPointSize, "shaderTessellationAndGeometryPointSize");
-    aFeaturesOut.shaderImageGatherExtended = aBinaryFunc(a.shaderImageGatherExtended, b.shaderImageGatherExtended, "shaderImageGatherExtended");
-    aFeaturesOut.shaderStorageImageExtendedFormats = aBinaryFunc(a.shaderStorageImageExtendedFormats, b.shaderStorageImageExtendedFormats, "shaderStorageImageExtendedFormats");
-    aFeaturesOut.shaderStorageImageMultisample = aBinaryFunc(a.shaderStorageImageMultisample, b.shaderStorageImageMultisample, "shaderStorageImageMultisample");
-    aFeaturesOut.shaderStorageImageReadWithoutFormat = aBinaryFunc(a.shaderStorageImageReadWithoutFormat, b.shaderStorageImageReadWithoutFormat, "shaderStorageImageReadWithoutFormat");
-    aFeaturesOut.shaderStorageImageWriteWithoutFormat = aBinaryFunc(a.shaderStorageImageWriteWithoutFormat, b.shaderStorageImageWriteWithoutFormat, "shaderStorageImageWriteWithoutFormat");
-    aFeaturesOut.shaderUniformBufferArrayDynamicIndexing = aBinaryFunc(a.shaderUniformBufferArrayDynamicIndexing, b.shaderUniformBufferArrayDynamicIndexing, "shaderUniformBufferArrayDynamicIndexing");
-    aFeaturesOut.shaderSampledImageArrayDynamicIndexing = aBinaryFunc(a.shaderSampledImageArrayDynamicIndexing, b.shaderSampledImageArrayDynamicIndexing, "shaderSampledImageArrayDynamicIndexing");
-    aFeaturesOut.shaderStorageBufferArrayDynamicIndexing = aBinaryFunc(a.shaderStorageBufferArrayDynamicIndexing, b.shaderStorageBufferArrayDynamicIndexing, "shaderStorageBufferArrayDynamicIndexing");
-    aFeaturesOut.shaderStorageImageArrayDynamicIndexing = aBinaryFunc(a.shaderStorageImageArrayDynamicIndexing, b.shaderStorageImageArrayDynamicIndexing, "shaderStorageImageArrayDynamicIndexing");
-    aFeaturesOut.shaderClipDistance = aBinaryFunc(a.shaderClipDistance, b.shaderClipDistance, "shaderClipDistance");
-    aFeaturesOut.shaderCullDistance = aBinaryFunc(a.shaderCullDistance, b.shaderCullDistance, "shaderCullDistance");
-    aFeaturesOut.shaderFloat64 = aBinaryFunc(a.shaderFloat64, b.shaderFloat64, "shaderFloat64");
-    aFeaturesOut.shaderInt64 = aBinaryFunc(a.shaderInt64, b.shaderInt64, "shaderInt64");
-    aFeaturesOut.shaderInt16 = aBinaryFunc(a.shaderInt16, b.shaderInt16, "shaderInt16");
-    aFeaturesOut.shaderResourceResidency = aBinaryFunc(a.shaderResourceResidency, b.shaderResourceResidency, "shaderResourceResidency");
-    aFeaturesOut.shaderResourceMinLod = aBinaryFunc(a.shaderResourceMinLod, b.shaderResourceMinLod, "shaderResourceMinLod");
-    aFeaturesOut.sparseBinding = aBinaryFunc(a.sparseBinding, b.sparseBinding, "sparseBinding");
-    aFeaturesOut.sparseResidencyBuffer = aBinaryFunc(a.sparseResidencyBuffer, b.sparseResidencyBuffer, "sparseResidencyBuffer");
-    aFeaturesOut.sparseResidencyImage2D = aBinaryFunc(a.sparseResidencyImage2D, b.sparseResidencyImage2D, "sparseResidencyImage2D");
-    aFeaturesOut.sparseResidencyImage3D = aBinaryFunc(a.sparseResidencyImage3D, b.sparseResidencyImage3D, "sparseResidencyImage3D");
-    aFeaturesOut.sparseResidency2Samples = aBinaryFunc(a.sparseResidency2Samples, b.sparseResidency2Samples, "sparseResidency2Samples");
-    aFeaturesOut.sparseResidency4Samples = aBinaryFunc(a.sparseResidency4Samples, b.sparseResidency4Samples, "sparseResidency4Samples");
-    aFeaturesOut.sparseResidency8Samples = aBinaryFunc(a.sparseResidency8Samples, b.sparseResidency8Samples, "sparseResidency8Samples");
-    aFeaturesOut.sparseResidency16Samples = aBinaryFunc(a.sparseResidency16Samples, b.sparseResidency16Samples, "sparseResidency16Samples");
-    aFeaturesOut.sparseResidencyAliased = aBinaryFunc(a.sparseResidencyAliased, b.sparseResidencyAliased, "sparseResidencyAliased");
-    aFeaturesOut.variableMultisampleRate = aBinaryFunc(a.variableMultisampleRate, b.variableMultisampleRate, "variableMultisampleRate");
-    aFeaturesOut.inheritedQueries = aBinaryFunc(a.inheritedQueries, b.inheritedQueries, "inheritedQueries");
+    visit_phys_device_features(a, b, aFeaturesOut, aBinaryFunc);
 }
 
 void unary_op_phys_device_features(
@@ -358,61 +843,7 @@ void unary_op_phys_device_features(
     VkPhysicalDeviceFeatures& aFeaturesOut,
     const std::function<VkBool32(VkBool32, const char*)>& aUnaryFunc
 ){
-    aFeaturesOut.robustBufferAccess = aUnaryFunc(aFeaturesIn.robustBufferAccess, "robustBufferAccess");
-    aFeaturesOut.fullDrawIndexUint32 = aUnaryFunc(aFeaturesIn.fullDrawIndexUint32, "fullDrawIndexUint32");
-    aFeaturesOut.imageCubeArray = aUnaryFunc(aFeaturesIn.imageCubeArray, "imageCubeArray");
-    aFeaturesOut.independentBlend = aUnaryFunc(aFeaturesIn.independentBlend, "independentBlend");
-    aFeaturesOut.geometryShader = aUnaryFunc(aFeaturesIn.geometryShader, "geometryShader");
-    aFeaturesOut.tessellationShader = aUnaryFunc(aFeaturesIn.tessellationShader, "tessellationShader");
-    aFeaturesOut.sampleRateShading = aUnaryFunc(aFeaturesIn.sampleRateShading, "sampleRateShading");
-    aFeaturesOut.dualSrcBlend = aUnaryFunc(aFeaturesIn.dualSrcBlend, "dualSrcBlend");
-    aFeaturesOut.logicOp = aUnaryFunc(aFeaturesIn.logicOp, "logicOp");
-    aFeaturesOut.multiDrawIndirect = aUnaryFunc(aFeaturesIn.multiDrawIndirect, "multiDrawIndirect");
-    aFeaturesOut.drawIndirectFirstInstance = aUnaryFunc(aFeaturesIn.drawIndirectFirstInstance, "drawIndirectFirstInstance");
-    aFeaturesOut.depthClamp = aUnaryFunc(aFeaturesIn.depthClamp, "depthClamp");
-    aFeaturesOut.depthBiasClamp = aUnaryFunc(aFeaturesIn.depthBiasClamp, "depthBiasClamp");
-    aFeaturesOut.fillModeNonSolid = aUnaryFunc(aFeaturesIn.fillModeNonSolid, "fillModeNonSolid");
-    aFeaturesOut.depthBounds = aUnaryFunc(aFeaturesIn.depthBounds, "depthBounds");
-    aFeaturesOut.wideLines = aUnaryFunc(aFeaturesIn.wideLines, "wideLines");
-    aFeaturesOut.largePoints = aUnaryFunc(aFeaturesIn.largePoints, "largePoints");
-    aFeaturesOut.alphaToOne = aUnaryFunc(aFeaturesIn.alphaToOne, "alphaToOne");
-    aFeaturesOut.multiViewport = aUnaryFunc(aFeaturesIn.multiViewport, "multiViewport");
-    aFeaturesOut.samplerAnisotropy = aUnaryFunc(aFeaturesIn.samplerAnisotropy, "samplerAnisotropy");
-    aFeaturesOut.textureCompressionETC2 = aUnaryFunc(aFeaturesIn.textureCompressionETC2, "textureCompressionETC2");
-    aFeaturesOut.textureCompressionASTC_LDR = aUnaryFunc(aFeaturesIn.textureCompressionASTC_LDR, "textureCompressionASTC_LDR");
-    aFeaturesOut.textureCompressionBC = aUnaryFunc(aFeaturesIn.textureCompressionBC, "textureCompressionBC");
-    aFeaturesOut.occlusionQueryPrecise = aUnaryFunc(aFeaturesIn.occlusionQueryPrecise, "occlusionQueryPrecise");
-    aFeaturesOut.pipelineStatisticsQuery = aUnaryFunc(aFeaturesIn.pipelineStatisticsQuery, "pipelineStatisticsQuery");
-    aFeaturesOut.vertexPipelineStoresAndAtomics = aUnaryFunc(aFeaturesIn.vertexPipelineStoresAndAtomics, "vertexPipelineStoresAndAtomics");
-    aFeaturesOut.fragmentStoresAndAtomics = aUnaryFunc(aFeaturesIn.fragmentStoresAndAtomics, "fragmentStoresAndAtomics");
-    aFeaturesOut.shaderTessellationAndGeometryPointSize = aUnaryFunc(aFeaturesIn.shaderTessellationAndGeometryPointSize, "shaderTessellationAndGeometryPointSize");
-    aFeaturesOut.shaderImageGatherExtended = aUnaryFunc(aFeaturesIn.shaderImageGatherExtended, "shaderImageGatherExtended");
-    aFeaturesOut.shaderStorageImageExtendedFormats = aUnaryFunc(aFeaturesIn.shaderStorageImageExtendedFormats, "shaderStorageImageExtendedFormats");
-    aFeaturesOut.shaderStorageImageMultisample = aUnaryFunc(aFeaturesIn.shaderStorageImageMultisample, "shaderStorageImageMultisample");
-    aFeaturesOut.shaderStorageImageReadWithoutFormat = aUnaryFunc(aFeaturesIn.shaderStorageImageReadWithoutFormat, "shaderStorageImageReadWithoutFormat");
-    aFeaturesOut.shaderStorageImageWriteWithoutFormat = aUnaryFunc(aFeaturesIn.shaderStorageImageWriteWithoutFormat, "shaderStorageImageWriteWithoutFormat");
-    aFeaturesOut.shaderUniformBufferArrayDynamicIndexing = aUnaryFunc(aFeaturesIn.shaderUniformBufferArrayDynamicIndexing, "shaderUniformBufferArrayDynamicIndexing");
-    aFeaturesOut.shaderSampledImageArrayDynamicIndexing = aUnaryFunc(aFeaturesIn.shaderSampledImageArrayDynamicIndexing, "shaderSampledImageArrayDynamicIndexing");
-    aFeaturesOut.shaderStorageBufferArrayDynamicIndexing = aUnaryFunc(aFeaturesIn.shaderStorageBufferArrayDynamicIndexing, "shaderStorageBufferArrayDynamicIndexing");
-    aFeaturesOut.shaderStorageImageArrayDynamicIndexing = aUnaryFunc(aFeaturesIn.shaderStorageImageArrayDynamicIndexing, "shaderStorageImageArrayDynamicIndexing");
-    aFeaturesOut.shaderClipDistance = aUnaryFunc(aFeaturesIn.shaderClipDistance, "shaderClipDistance");
-    aFeaturesOut.shaderCullDistance = aUnaryFunc(aFeaturesIn.shaderCullDistance, "shaderCullDistance");
-    aFeaturesOut.shaderFloat64 = aUnaryFunc(aFeaturesIn.shaderFloat64, "shaderFloat64");
-    aFeaturesOut.shaderInt64 = aUnaryFunc(aFeaturesIn.shaderInt64, "shaderInt64");
-    aFeaturesOut.shaderInt16 = aUnaryFunc(aFeaturesIn.shaderInt16, "shaderInt16");
-    aFeaturesOut.shaderResourceResidency = aUnaryFunc(aFeaturesIn.shaderResourceResidency, "shaderResourceResidency");
-    aFeaturesOut.shaderResourceMinLod = aUnaryFunc(aFeaturesIn.shaderResourceMinLod, "shaderResourceMinLod");
-    aFeaturesOut.sparseBinding = aUnaryFunc(aFeaturesIn.sparseBinding, "sparseBinding");
-    aFeaturesOut.sparseResidencyBuffer = aUnaryFunc(aFeaturesIn.sparseResidencyBuffer, "sparseResidencyBuffer");
-    aFeaturesOut.sparseResidencyImage2D = aUnaryFunc(aFeaturesIn.sparseResidencyImage2D, "sparseResidencyImage2D");
-    aFeaturesOut.sparseResidencyImage3D = aUnaryFunc(aFeaturesIn.sparseResidencyImage3D, "sparseResidencyImage3D");
-    aFeaturesOut.sparseResidency2Samples = aUnaryFunc(aFeaturesIn.sparseResidency2Samples, "sparseResidency2Samples");
-    aFeaturesOut.sparseResidency4Samples = aUnaryFunc(aFeaturesIn.sparseResidency4Samples, "sparseResidency4Samples");
-    aFeaturesOut.sparseResidency8Samples = aUnaryFunc(aFeaturesIn.sparseResidency8Samples, "sparseResidency8Samples");
-    aFeaturesOut.sparseResidency16Samples = aUnaryFunc(aFeaturesIn.sparseResidency16Samples, "sparseResidency16Samples");
-    aFeaturesOut.sparseResidencyAliased = aUnaryFunc(aFeaturesIn.sparseResidencyAliased, "sparseResidencyAliased");
-    aFeaturesOut.variableMultisampleRate = aUnaryFunc(aFeaturesIn.variableMultisampleRate, "variableMultisampleRate");
-    aFeaturesOut.inheritedQueries = aUnaryFunc(aFeaturesIn.inheritedQueries, "inheritedQueries");
+    visit_phys_device_features(aFeaturesIn, aFeaturesOut, aUnaryFunc);
 }
 
 
@@ -421,52 +852,58 @@ void unary_op_phys_device_features(
 } // end namespace vkutils
 
 
-static bool confirm_queue_fam(VkPhysicalDevice aDevice, uint32_t aBitmask){
-    uint32_t queueCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(aDevice, &queueCount, nullptr);
-    std::vector<VkQueueFamilyProperties> queueProperties(queueCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(aDevice, &queueCount, queueProperties.data());
-
-    uint32_t maskResult = 0;
-    for(const VkQueueFamilyProperties& queueFamily : queueProperties){
-        if(queueFamily.queueCount > 0)
-            maskResult = maskResult | (aBitmask & queueFamily.queueFlags);
-    }
-
-    return(maskResult == aBitmask);
-}
-
-static int score_physical_device(VkPhysicalDevice aDevice){
-    VkPhysicalDeviceProperties properties;
-    VkPhysicalDeviceFeatures features;
-    vkGetPhysicalDeviceProperties(aDevice, &properties);
-    vkGetPhysicalDeviceFeatures(aDevice, &features);
-
-    int score = 0;
+static vkutils::PhysicalDeviceScore score_physical_device(const VulkanPhysicalDevice& aDevice){
+    vkutils::PhysicalDeviceScore score;
+    score.device = aDevice.handle();
 
+    const VkPhysicalDeviceProperties& properties = aDevice.mProperties;
     switch(properties.deviceType){
         case VK_PHYSICAL_DEVICE_TYPE_OTHER:
-            score += 0000;
+            score.deviceType = 0.0f;
             break;
         case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
-            score += 2000;
+            score.deviceType = 0.5f;
             break;
         case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
-            score += 4000;
+            score.deviceType = 1.0f;
             break;
         case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
-            score += 3000;
+            score.deviceType = 0.75f;
             break;
         case VK_PHYSICAL_DEVICE_TYPE_CPU:
-            score += 1000;
+            score.deviceType = 0.25f;
             break;
         default:
             break;
     }
 
-    score = confirm_queue_fam(aDevice, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT) ? score : -1;
+    score.maxComputeWorkGroupInvocations = properties.limits.maxComputeWorkGroupInvocations;
+    score.subgroupSizeValue = aDevice.mSubgroupSize;
+
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = aDevice.mMemoryProperties;
+    for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i){
+        if(memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) score.deviceLocalBytes += memoryProperties.memoryHeaps[i].size;
+    }
 
-    //TODO: More metrics
+    uint32_t coreMask = 0;
+    bool anyTimestamps = false;
+    for(const QueueFamily& queueFamily : aDevice.mQueueFamilies){
+        if(queueFamily.mCount == 0) continue;
+        coreMask |= queueFamily.mFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+        anyTimestamps = anyTimestamps || queueFamily.mTimeStampValidBits > 0;
+
+        if(queueFamily.mTransfer && !queueFamily.mGraphics){
+            float dedication = queueFamily.mCompute ? 0.5f : 1.0f;
+            score.dedicatedTransfer = std::max(score.dedicatedTransfer, dedication);
+        }
+    }
+
+    if(properties.limits.timestampComputeAndGraphics){
+        score.timestamps = 1.0f;
+    }else if(anyTimestamps){
+        score.timestamps = 0.5f;
+    }
 
+    score.eligible = coreMask == (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
     return(score);
 }
@@ -10,7 +10,19 @@
 #include <algorithm>
 #include <iostream>
 #include <functional>
+#include <limits>
 #include <cassert>
+#include <atomic>
+#include <array>
+#include <bitset>
+#include <utility>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vk_mem_alloc.h>
 #include "VulkanDevices.h"
 
@@ -24,6 +36,9 @@ namespace vkutils{
 
 std::vector<const char*> strings_to_cstrs(const std::vector<std::string>& aContainer);
 
+// Inline include physical device feature table components
+#include "vkutils_FeatureTable.inl"
+
 template<typename ContainerType>
 void find_extension_matches(
     const std::vector<VkExtensionProperties>& aAvailable,
@@ -38,7 +53,35 @@ void find_layer_matches(
     std::vector<std::string>& aOutExtList, std::unordered_map<std::string, bool>* aResultMap = nullptr
 );
 
+/// Matches names against a hashed index, one O(1) lookup per name. Pointers added to aOutExtList point into
+/// aAvailable's storage, so the list can be handed straight to ppEnabledExtensionNames. If aRequestedFound is
+/// given, entry i says whether the i-th name of aRequested was found.
+///
+/// \throw std::runtime_error If any name in `aRequired` is not available
+template<typename ContainerType>
+void find_extension_matches(
+    const PropertyNameIndex& aAvailable,
+    const ContainerType& aRequired, const ContainerType& aRequested,
+    std::vector<const char*>& aOutExtList, std::vector<bool>* aRequestedFound = nullptr
+);
+
+/// Layer form of the indexed find_extension_matches(). Pass PropertyNameIndex::instanceLayers() as aAvailable.
+template<typename ContainerType>
+void find_layer_matches(
+    const PropertyNameIndex& aAvailable,
+    const ContainerType& aRequired, const ContainerType& aRequested,
+    std::vector<const char*>& aOutLayerList, std::vector<bool>* aRequestedFound = nullptr
+);
+
+template<typename ContainerType>
+void _find_name_matches(
+    const PropertyNameIndex& aAvailable,
+    const ContainerType& aRequired, const ContainerType& aRequested,
+    std::vector<const char*>& aOutList, std::vector<bool>* aRequestedFound, const char* aKind
+);
+
 /// Applies binary function returning bool to each member within VkPhysicalDeviceFeatures.
+/// Prefer visit_phys_device_features(), which inlines the operation instead of calling through std::function.
 ///
 /// \param[out] aFeaturesOut Output structure containing result of the operation
 /// \param aBinaryFunc std::function reference for binary function to apply. Must be compatible with with
@@ -53,6 +96,7 @@ void boolean_op_phys_device_features(
 );
 
 /// Applies unary function returning bool to each member within VkPhysicalDeviceFeatures.
+/// Prefer visit_phys_device_features(), which inlines the operation instead of calling through std::function.
 ///
 /// \param[in] aFeaturesIn Input structure
 /// \param[out] aFeaturesOut Output structure for containing result of the operation
@@ -80,24 +124,40 @@ inline void find_feature_matches(
     const VkPhysicalDeviceFeatures& aRequested,
     VkPhysicalDeviceFeatures& aFeaturesOut
 ){
-    std::function requiredAnd = [](VkBool32 a, VkBool32 b, const char* name) -> VkBool32 {
-        if(a && !b){
-            throw std::runtime_error("Error: Feature '" + std::string(name) + "' is required, but not available on the given device!");
+    const PhysicalDeviceFeatureBits available = features_to_bits(aAvailable);
+    const PhysicalDeviceFeatureBits required = features_to_bits(aRequired);
+    const PhysicalDeviceFeatureBits requested = features_to_bits(aRequested);
+
+    const PhysicalDeviceFeatureBits missingRequired = required & ~available;
+    if(missingRequired.any()){
+        for(size_t i = 0; i < sPhysicalDeviceFeatureCount; ++i){
+            if(missingRequired[i]){
+                throw std::runtime_error("Error: Feature '" + std::string(sPhysicalDeviceFeatureTable[i].name) + "' is required, but not available on the given device!");
+            }
         }
-        return(a);
-    };
+    }
 
-    std::function requestedAnd = [](VkBool32 a, VkBool32 b, const char* name) -> VkBool32 {
-        if(a && !b){
-            std::cerr << "Warning: Feature '" << std::string(name) << "' is requested, but not available on the given device!" << std::endl;
+    const PhysicalDeviceFeatureBits missingRequested = requested & ~available;
+    for(size_t i = 0; missingRequested.any() && i < sPhysicalDeviceFeatureCount; ++i){
+        if(missingRequested[i]){
+            std::cerr << "Warning: Feature '" << sPhysicalDeviceFeatureTable[i].name << "' is requested, but not available on the given device!" << std::endl;
         }
-        return(a);
-    };
+    }
 
-    boolean_op_phys_device_features(aRequested, aAvailable, aFeaturesOut, requestedAnd);
-    boolean_op_phys_device_features(aRequired, aAvailable, aFeaturesOut, requiredAnd);
+    aFeaturesOut = bits_to_features(required | (requested & available));
 }
 
+/// find_feature_matches() over VkPhysicalDeviceFeatures and the Vulkan 1.1, 1.2 and 1.3 feature structs.
+/// Pass VulkanPhysicalDevice::mFeatureChain as `aAvailable`.
+/// 
+/// \throw std::runtime_error If any features enabled in `aRequired` are not present in `aAvailable`
+void find_feature_matches(
+    const VulkanFeatureChain& aAvailable,
+    const VulkanFeatureChain& aRequired,
+    const VulkanFeatureChain& aRequested,
+    VulkanFeatureChain& aFeaturesOut
+);
+
 uint32_t total_descriptor_count(const std::vector<VkDescriptorPoolSize>& aPoolSizes);
 
 /// Concatenates specialization info specified in `a` with specialization info in `b`, storing the result in `out`
@@ -113,47 +173,348 @@ std::pair<std::vector<VkSpecializationMapEntry>, std::vector<uint8_t>> concat_sp
     VkSpecializationInfo& out
 );
 
-VkPhysicalDevice select_physical_device(const std::vector<VkPhysicalDevice>& aDevices);
+/// Weights applied to each criterion of PhysicalDeviceScore. Criterion scores are in [0, 1], so a weight is
+/// the most that criterion can add. Device type scores are 0.25 apart, so device type alone orders devices
+/// of different types only while 0.25 * deviceType is greater than the sum of the other weights. The
+/// defaults keep that invariant (3.0 > 2.5), leaving the remaining criteria to decide between devices of one type.
+struct DeviceScoreWeights
+{
+    float deviceType = 12.0f;
+    float deviceLocalMemory = 1.0f;
+    float computeInvocations = 0.5f;
+    float dedicatedTransfer = 0.5f;
+    float timestamps = 0.25f;
+    float subgroupSize = 0.25f;
+};
+
+/// Per-criterion scores of one physical device. Memory, compute invocations and subgroup size are
+/// relative to the best device in the ranked set.
+struct PhysicalDeviceScore
+{
+    VkPhysicalDevice device = VK_NULL_HANDLE;
+
+    /// False when the device lacks graphics or compute queues. Ineligible devices rank last with a total of -1.
+    bool eligible = false;
+    float total = -1.0f;
+
+    float deviceType = 0.0f;
+    float deviceLocalMemory = 0.0f;
+    float computeInvocations = 0.0f;
+    float dedicatedTransfer = 0.0f;
+    float timestamps = 0.0f;
+    float subgroupSize = 0.0f;
+
+    // Raw values behind the relative scores
+    VkDeviceSize deviceLocalBytes = 0;
+    uint32_t maxComputeWorkGroupInvocations = 0;
+    uint32_t subgroupSizeValue = 0;
+};
+
+/// Score every device in aDevices and return them ordered best first. Handles of aInstance are ranked from the
+/// VulkanPhysicalDevice::getCached() snapshots, so repeated ranking issues no new queries. Without the instance
+/// and its API version every device is queried anew and judged as a Vulkan 1.0 device.
+std::vector<PhysicalDeviceScore> rank_physical_devices(const VulkanPhysicalDeviceEnumeration& aDevices, const DeviceScoreWeights& aWeights = DeviceScoreWeights());
+std::vector<PhysicalDeviceScore> rank_physical_devices(
+    const std::vector<VkPhysicalDevice>& aDevices,
+    const DeviceScoreWeights& aWeights = DeviceScoreWeights(),
+    VkInstance aInstance = VK_NULL_HANDLE,
+    uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+);
+
+/// \returns The best eligible device from rank_physical_devices(), or VK_NULL_HANDLE if none are eligible
+VkPhysicalDevice select_physical_device(const VulkanPhysicalDeviceEnumeration& aDevices, const DeviceScoreWeights& aWeights = DeviceScoreWeights());
+VkPhysicalDevice select_physical_device(
+    const std::vector<VkPhysicalDevice>& aDevices,
+    const DeviceScoreWeights& aWeights = DeviceScoreWeights(),
+    VkInstance aInstance = VK_NULL_HANDLE,
+    uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+);
 
 /// @brief Returns cstr name of the given VkResult enum value. 
 const char* vk_result_str(VkResult r);
 
 VkFormat select_depth_format(const VkPhysicalDevice& aPhysDev, const VkFormat& aPreferred = VK_FORMAT_D24_UNORM_S8_UINT, bool aRequireStencil = false);
 
+/// Memory map the SPIR-V file at aFilePath and create a shader module straight from the mapped pages.
+/// Throws if the file cannot be opened or does not look like SPIR-V.
 VkShaderModule load_shader_module(const VkDevice& aDevice, const std::string& aFilePath);
 VkShaderModule create_shader_module(const VkDevice& aDevice, const std::vector<uint8_t>& aByteCode, bool silent = false);
+VkShaderModule create_shader_module(const VkDevice& aDevice, const uint32_t* aCode, size_t aCodeSize, bool silent = false);
+
+class SubmitBatcher;
+class SynchronizedQueue;
+
+/// Timeline semaphore (Vulkan 1.2 or VK_KHR_timeline_semaphore) whose signal values increase monotonically.
+///
+/// Attached to a QueueClosure, every submit of that closure signals the next value. CPU threads can then 
+/// wait for "value >= N" without a fence per submission, and other queues can wait on the same values.
+/// The device must have been created with the `timelineSemaphore` feature enabled. 
+class TimelineSemaphore
+{
+ public:
+    TimelineSemaphore(){}
+
+    /// \throw std::runtime_error If the semaphore cannot be created
+    TimelineSemaphore(VkDevice aDevice, uint64_t aInitialValue = 0);
+    ~TimelineSemaphore(){destroy();}
+
+    TimelineSemaphore(const TimelineSemaphore&) = delete;
+    TimelineSemaphore& operator=(const TimelineSemaphore&) = delete;
+
+    VkSemaphore handle() const {return(mSemaphore);}
+    bool isValid() const {return(mSemaphore != VK_NULL_HANDLE);}
+
+    /// Highest value that has been handed to the queue or signaled from the host.
+    uint64_t getLastSubmittedValue() const {return(_mLastSubmitted.load(std::memory_order_acquire));}
+
+    /// Query the current counter value of the semaphore.
+    uint64_t getCompletedValue() const;
+
+    /// True if the counter has reached `aValue`. Only queries the device when the last observed value is lower.
+    bool isReached(uint64_t aValue) const;
+
+    /// Block until the counter reaches `aValue` or `aTimeoutNs` elapses.
+    VkResult wait(uint64_t aValue, uint64_t aTimeoutNs = std::numeric_limits<uint64_t>::max()) const;
+
+    /// Signal `aValue` from the host. `aValue` must be greater than getLastSubmittedValue().
+    VkResult signal(uint64_t aValue);
+
+    void destroy();
+
+ protected:
+    friend class QueueClosure;
+
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VkSemaphore mSemaphore = VK_NULL_HANDLE;
+
+ private:
+    // Held from value reservation until the submit reaches the queue so values are signaled in order 
+    std::mutex _mSubmitMutex;
+    std::atomic<uint64_t> _mLastSubmitted{0};
+    mutable std::atomic<uint64_t> _mCompletedCache{0};
+
+    // Several threads may race to refresh the cache, so it only ever moves forward
+    void _raiseCompletedCache(uint64_t aValue) const;
+};
+
+/// Handle to the completion of a single submission made through a QueueClosure.
+///
+/// Handles are cheap to copy and share the state of the submission they were created for. Waiting on
+/// a handle blocks on that submission's fence or timeline value only, never on the rest of the queue. A 
+/// default constructed handle refers to no submission and always reports as complete. 
+class SubmitHandle
+{
+ public:
+    SubmitHandle(){}
+
+    bool isValid() const {return(_mState != nullptr);}
+
+    /// Non-blocking check for completion. 
+    bool poll() const;
+
+    /// Block until the submission completes or `aTimeoutNs` elapses.
+    /// \returns VK_SUCCESS on completion, VK_TIMEOUT if the timeout elapsed, VK_NOT_READY for a batched 
+    ///          submission which has not been flushed, or the error the submission failed with
+    VkResult wait(uint64_t aTimeoutNs = std::numeric_limits<uint64_t>::max()) const;
+
+    /// Attach a function to run once completion is observed. Continuations run on whichever thread observes 
+    /// completion first: a call to poll() or wait(), or the owning QueueClosure recycling the submission. A
+    /// continuation attached after completion runs immediately on the calling thread. Continuations must not 
+    /// submit work through the QueueClosure that recycles them.
+    ///
+    /// Continuations also run when the submission fails to reach the queue, on the thread whose submit failed.
+    /// wait() on the handle then returns the error.
+    void then(std::function<void()> aContinuation);
+
+    /// Timeline semaphore and value the submission signals, so that a submit on another queue can wait for it
+    /// through the wait values of QueueClosure or SubmitBatcher. VK_NULL_HANDLE for fence backed submissions
+    /// and for batched submissions which have not been flushed.
+    VkSemaphore getTimeline() const;
+    uint64_t getTimelineValue() const;
+
+ protected:
+    friend class QueueClosure;
+    friend class SubmitBatcher;
+
+    struct _State
+    {
+        _State(VkDevice aDevice, VkFence aFence) : device(aDevice), fence(aFence) {}
+        _State(VkDevice aDevice, VkSemaphore aTimeline, uint64_t aValue) : device(aDevice), timeline(aTimeline), timelineValue(aValue) {}
+
+        // Returns VK_SUCCESS once the fence or timeline value has been observed signaled. When `aBlockOnLock`
+        // is false and another thread holds the state, returns VK_NOT_READY instead of waiting for it. 
+        VkResult check(uint64_t aTimeoutNs, bool aBlockOnLock = true);
+
+        // Complete a timeline backed state without querying the device, given an already observed counter value
+        bool resolveReached(uint64_t aCompletedValue);
+
+        // Mark complete and run continuations. Releases `aLock`.
+        void _resolve(std::unique_lock<std::mutex>& aLock);
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkSemaphore timeline = VK_NULL_HANDLE;
+        uint64_t timelineValue = 0;
+        VkResult status = VK_SUCCESS;
+        bool submitted = true;
+        bool complete = false;
+        std::mutex mutex;
+        std::vector<std::function<void()>> continuations;
+    };
+
+    SubmitHandle(const std::shared_ptr<_State>& aState) : _mState(aState) {}
+
+    std::shared_ptr<_State> _mState;
+};
 
 class QueueClosure
 {
  public:
-    QueueClosure(const VulkanDeviceHandlePair& aDevicePair, uint32_t aFamily, VkQueue aQueue)
-    : mQueue(aQueue), mFamilyIdx(aFamily), _mDevicePair(aDevicePair) {}
+    QueueClosure(const VulkanDeviceHandlePair& aDevicePair, uint32_t aFamily, VkQueue aQueue);
 
-    ~QueueClosure(){_cleanupSubmit();}
+    ~QueueClosure(){_releaseCommandRings();}
+
+    QueueClosure(const QueueClosure&) = delete;
+    QueueClosure& operator=(const QueueClosure&) = delete;
 
     VkQueue getQueue() const {return(mQueue);}
     uint32_t getFamily() const {return(mFamilyIdx);}
     const VulkanDeviceHandlePair& getDevicePair() const {return(_mDevicePair);}
 
+    /// Lock shared by every user of this closure's VkQueue, along with its submit statistics
+    const std::shared_ptr<SynchronizedQueue>& getSynchronizedQueue() const {return(_mSyncQueue);}
+
+    /// Attach a timeline semaphore which every subsequent submit of this closure signals with the next value.
+    /// While attached, submissions are tracked by their timeline value and no pooled fence is used. The
+    /// timeline must outlive the closure or be detached with `setTimeline(nullptr)`.
+    void setTimeline(TimelineSemaphore* aTimeline) {_mTimeline = aTimeline;}
+    TimelineSemaphore* getTimeline() const {return(_mTimeline);}
+
+    /// Timeline value signaled by the most recent submit of this closure, or 0 if no timeline is attached.
+    uint64_t getLastSignaledValue() const {return(_mLastTimelineValue.load(std::memory_order_acquire));}
+
+    /// Begin recording a primary one-time-submit command buffer.
+    ///
+    /// When `aCommandPool` is VK_NULL_HANDLE the command buffer is taken from a transient pool owned by the
+    /// calling thread. Such buffers are reset and reused once the fence of their submission has signaled, so 
+    /// they must be finished on the same thread that began them. Buffers allocated from a caller supplied 
+    /// pool are left for the caller to free. 
     VkCommandBuffer beginOneSubmitCommands(VkCommandPool aCommandPool = VK_NULL_HANDLE);
+
+    /// \param aFence Optional fence signaled once the submission completes, in which case the call does not wait.
+    ///               The closure does not track it, so it may be reset or destroyed as soon as it has signaled.
+    ///               Without a timeline attached it is signaled by a second, empty submit.
     VkResult finishOneSubmitCommands(const VkCommandBuffer& aCmdBuffer, VkFence aFence = VK_NULL_HANDLE, bool aShouldWait = true);
+    /// \param aWaitValues Values to wait for on timeline semaphores in `aWaitSemaphores`, matched by position.
+    ///                    Entries of binary semaphores are ignored, and missing entries are 0.
     VkResult finishOneSubmitCommands(
         const VkCommandBuffer& aCmdBuffer,
         const std::vector<VkSemaphore>& aWaitSemaphores,
         const std::vector<VkSemaphore>& aSignalSemaphores,
         VkFence aFence = VK_NULL_HANDLE,
-        bool aShouldWait = true
+        bool aShouldWait = true,
+        const std::vector<uint64_t>& aWaitValues = {}
     );
 
+    /// Submit the command buffer without waiting. The returned handle completes when this submission alone 
+    /// has finished executing. It is backed by the attached timeline if there is one, and otherwise by a 
+    /// fence drawn from, and returned to, the calling thread's pool.
+    ///
+    /// Work on another queue is chained by waiting on its timeline, e.g. for a compute closure consuming the
+    /// results of a transfer closure: `compute.finishOneSubmitCommandsAsync(cmd, {upload.getTimeline()}, {},
+    /// {upload.getTimelineValue()})`. Waits run at VK_PIPELINE_STAGE_ALL_COMMANDS_BIT.
+    ///
+    /// \param aWaitValues Values to wait for on timeline semaphores in `aWaitSemaphores`, matched by position.
+    ///                    Entries of binary semaphores are ignored, and missing entries are 0.
+    /// \throw std::runtime_error If vkQueueSubmit fails
+    SubmitHandle finishOneSubmitCommandsAsync(
+        const VkCommandBuffer& aCmdBuffer,
+        const std::vector<VkSemaphore>& aWaitSemaphores = {},
+        const std::vector<VkSemaphore>& aSignalSemaphores = {},
+        const std::vector<uint64_t>& aWaitValues = {}
+    );
+
+    /// Return the calling thread's completed command buffers to its free list. This happens implicitly
+    /// in beginOneSubmitCommands(), but may be called to reclaim buffers eagerly. 
+    void recycleCompletedCommands();
+
+    /// Destroy the calling thread's transient pool and fences once its submissions have completed. A thread's
+    /// pool is otherwise kept until the closure is destroyed, so threads that stop submitting, e.g. short lived
+    /// workers, should call this before they exit. Blocks on the thread's in-flight submissions.
+    /// \throw std::runtime_error If a command buffer begun on this thread has not been finished
+    void releaseThreadCommands();
+
  protected:
-    void _cleanupSubmit(const VkCommandBuffer& aCmdBuffer = VK_NULL_HANDLE);
+    // A submission tracked for recycling. `cmdBuffer` is only set for buffers from the internal pool.
+    // `state` is always backed by the attached timeline or by `ownedFence`, never by a caller supplied fence,
+    // and is observed so handles and recycling never race.
+    struct _InFlightCommands
+    {
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkFence ownedFence = VK_NULL_HANDLE;
+        std::shared_ptr<SubmitHandle::_State> state;
+    };
+
+    // Storage for the timeline values appended to a submit info. Must outlive the vkQueueSubmit call.
+    struct _TimelineSubmit
+    {
+        std::vector<VkSemaphore> signalSemaphores;
+        std::vector<uint64_t> signalValues;
+        std::vector<uint64_t> waitValues;
+        VkTimelineSemaphoreSubmitInfo info = {};
+    };
+
+    // Per-thread transient pool and the command buffers allocated from it. 
+    struct _CommandRing
+    {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> freeCmdBuffers;
+        std::vector<VkFence> freeFences;
+        std::vector<VkCommandBuffer> recording;
+        std::deque<_InFlightCommands> inFlight;
+    };
+
+    VkResult _submitOne(
+        const VkCommandBuffer& aCmdBuffer,
+        const std::vector<VkSemaphore>& aWaitSemaphores,
+        const std::vector<VkSemaphore>& aSignalSemaphores,
+        const std::vector<uint64_t>& aWaitValues,
+        VkFence aFence,
+        std::shared_ptr<SubmitHandle::_State>& aStateOut
+    );
+    friend class SubmitBatcher;
+    std::shared_ptr<SubmitHandle::_State> _createSubmitState();
+
+    // `aWaitValues` holds, for each submission, either nullptr or one value per wait semaphore
+    VkResult _submitBatch(
+        const std::vector<VkSubmitInfo>& aSubmissions,
+        const std::vector<const uint64_t*>& aWaitValues,
+        const std::vector<VkCommandBuffer>& aCmdBuffers,
+        const std::shared_ptr<SubmitHandle::_State>& aState
+    );
+
+    // Chain a VkTimelineSemaphoreSubmitInfo carrying `aWaitValues` (nullptr or one per wait semaphore) and, when
+    // `aSignalValue` is set, a signal of the attached timeline. Leaves the submission untouched if neither is given.
+    void _appendTimelineValues(VkSubmitInfo& aSubmission, const uint64_t* aWaitValues, const uint64_t* aSignalValue, _TimelineSubmit& aStorage) const;
+    bool _takeRecording(_CommandRing& aRing, VkCommandBuffer aCmdBuffer);
+    bool _isRetired(_InFlightCommands& aSubmitted, uint64_t aTimelineCompleted);
+    _CommandRing* _getThreadRing(bool aCreateIfMissing);
+    VkFence _acquireFence(_CommandRing& aRing);
+    void _recycleRing(_CommandRing& aRing);
+    // Waits up to aTimeoutNs for each in-flight submission, then destroys the ring's fences and pool
+    void _destroyRing(_CommandRing& aRing, uint64_t aTimeoutNs);
+    void _releaseCommandRings();
+
     VkQueue mQueue = VK_NULL_HANDLE;
     uint32_t mFamilyIdx;
 
  private:
     VulkanDeviceHandlePair _mDevicePair;
-    mutable bool _mCmdPoolInternal = false;
-    mutable VkCommandPool _mCommandPool = VK_NULL_HANDLE;
+    std::shared_ptr<SynchronizedQueue> _mSyncQueue;
+    std::mutex _mRingMutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<_CommandRing>> _mCommandRings;
+    TimelineSemaphore* _mTimeline = nullptr;
+    std::atomic<uint64_t> _mLastTimelineValue{0};
 };
 
 const static VkSubmitInfo sSingleSubmitTemplate {
@@ -168,84 +529,131 @@ const static VkSubmitInfo sSingleSubmitTemplate {
     /* pSignalSemaphores = */ nullptr
 };
 
+// Inline include synchronized queue components
+#include "vkutils_SynchronizedQueue.inl"
+
+// Inline include submission batching components
+#include "vkutils_SubmitBatcher.inl"
+
+// Inline include staging upload components
+#include "vkutils_StagingRing.inl"
+
+// Inline include shader module components
+#include "vkutils_ShaderModule.inl"
+
+// Inline include pipeline cache components
+#include "vkutils_PipelineCache.inl"
+
 // Inline include render pipeline components
 #include "vkutils_VulkanRenderPipeline.inl"
 
 // Inline include compute pipeline components
 #include "vkutils_VulkanComputePipeline.inl"
 
+// Inline include parallel pipeline compilation components
+#include "vkutils_PipelineCompiler.inl"
+
+// Inline include background shader and pipeline warm-up components
+#include "vkutils_PipelineWarmup.inl"
+
+// Inline include multi-GPU compute components
+#include "vkutils_ComputeDeviceGroup.inl"
+
+// Inline include memory defragmentation components
+#include "vkutils_Defragmentation.inl"
+
+// Inline include memory budget components
+#include "vkutils_MemoryBudget.inl"
+
+// Inline include transient allocation pool components
+#include "vkutils_TransientPool.inl"
+
 
 } // end namespace vkutils
 
 template<typename ContainerType>
-void vkutils::find_extension_matches(
-    const std::vector<VkExtensionProperties>& aAvailable,
+void vkutils::_find_name_matches(
+    const PropertyNameIndex& aAvailable,
     const ContainerType& aRequired, const ContainerType& aRequested,
-    std::vector<std::string>& aOutExtList, std::unordered_map<std::string, bool>* aResultMap
+    std::vector<const char*>& aOutList, std::vector<bool>* aRequestedFound, const char* aKind
 ){
-    for(std::string ext_name : aRequested){
-        auto streq = [ext_name](const VkExtensionProperties& other) -> bool {return(ext_name == other.extensionName);};
-        std::vector<VkExtensionProperties>::const_iterator match = std::find_if(aAvailable.begin(), aAvailable.end(), streq);
-        if(match != aAvailable.end()){
-            aOutExtList.emplace_back(match->extensionName);
-            if(aResultMap != nullptr){
-                aResultMap->operator[](match->extensionName) = true;
-            }
+    aOutList.reserve(aOutList.size() + std::distance(std::begin(aRequired), std::end(aRequired)) + std::distance(std::begin(aRequested), std::end(aRequested)));
+    if(aRequestedFound != nullptr) aRequestedFound->clear();
+
+    for(const auto& name : aRequested){
+        const char* match = aAvailable.find(name);
+        if(match != nullptr){
+            aOutList.push_back(match);
         }else{
-            if(aResultMap != nullptr){
-                aResultMap->operator[](ext_name) = false;
-            }
-            std::cerr << "Warning: Requested extension " + std::string(ext_name) + " is not available" << std::endl;
+            std::cerr << "Warning: Requested " << aKind << " " << name << " is not available" << std::endl;
         }
+        if(aRequestedFound != nullptr) aRequestedFound->push_back(match != nullptr);
     }
 
-    for(std::string ext_name : aRequired){
-        auto streq = [ext_name](const VkExtensionProperties& other) -> bool {return(ext_name == other.extensionName);};
-        std::vector<VkExtensionProperties>::const_iterator match = std::find_if(aAvailable.begin(), aAvailable.end(), streq);
-        if(match != aAvailable.end()){
-            aOutExtList.emplace_back(match->extensionName);
-            if(aResultMap != nullptr){
-                aResultMap->operator[](match->extensionName) = true;
-            }
-        }else{
-            throw std::runtime_error("Required instance extension " + std::string(ext_name) + " is not available!");
+    for(const auto& name : aRequired){
+        const char* match = aAvailable.find(name);
+        if(match == nullptr){
+            throw std::runtime_error("Required " + std::string(aKind) + " " + std::string(name) + " is not available!");
         }
+        aOutList.push_back(match);
     }
 }
 
+template<typename ContainerType>
+void vkutils::find_extension_matches(
+    const PropertyNameIndex& aAvailable,
+    const ContainerType& aRequired, const ContainerType& aRequested,
+    std::vector<const char*>& aOutExtList, std::vector<bool>* aRequestedFound
+){
+    _find_name_matches(aAvailable, aRequired, aRequested, aOutExtList, aRequestedFound, "extension");
+}
+
 template<typename ContainerType>
 void vkutils::find_layer_matches(
-    const std::vector<VkLayerProperties>& aAvailable,
+    const PropertyNameIndex& aAvailable,
+    const ContainerType& aRequired, const ContainerType& aRequested,
+    std::vector<const char*>& aOutLayerList, std::vector<bool>* aRequestedFound
+){
+    _find_name_matches(aAvailable, aRequired, aRequested, aOutLayerList, aRequestedFound, "validation layer");
+}
+
+template<typename ContainerType>
+void vkutils::find_extension_matches(
+    const std::vector<VkExtensionProperties>& aAvailable,
     const ContainerType& aRequired, const ContainerType& aRequested,
     std::vector<std::string>& aOutExtList, std::unordered_map<std::string, bool>* aResultMap
 ){
-    for(std::string layer_name : aRequested){
-        auto streq = [layer_name](const VkLayerProperties& other) -> bool {return(layer_name == other.layerName);};
-        std::vector<VkLayerProperties>::const_iterator match = std::find_if(aAvailable.begin(), aAvailable.end(), streq);
-        if(match != aAvailable.end()){
-            aOutExtList.emplace_back(match->layerName);
-            if(aResultMap != nullptr){
-                aResultMap->operator[](match->layerName) = true;
-            }
-        }else{
-            if(aResultMap != nullptr){
-                aResultMap->operator[](layer_name) = false;
-            }
-            std::cerr << "Warning: Requested validation layer " + std::string(layer_name) + " is not available" << std::endl;
-        }
+    std::vector<const char*> matches;
+    std::vector<bool> requestedFound;
+    // matches points into the index's copies of the names, so it must outlive the copy into aOutExtList
+    const PropertyNameIndex index(aAvailable);
+    find_extension_matches(index, aRequired, aRequested, matches, &requestedFound);
+    aOutExtList.insert(aOutExtList.end(), matches.begin(), matches.end());
+
+    if(aResultMap != nullptr){
+        size_t i = 0;
+        for(const auto& name : aRequested) aResultMap->operator[](std::string(name)) = requestedFound[i++];
+        for(const auto& name : aRequired) aResultMap->operator[](std::string(name)) = true;
     }
+}
 
-    for(std::string layer_name : aRequired){
-        auto streq = [layer_name](const VkLayerProperties& other) -> bool {return(layer_name == other.layerName);};
-        std::vector<VkLayerProperties>::const_iterator match = std::find_if(aAvailable.begin(), aAvailable.end(), streq);
-        if(match != aAvailable.end()){
-            aOutExtList.emplace_back(match->layerName);
-            if(aResultMap != nullptr){
-                aResultMap->operator[](match->layerName) = true;
-            }
-        }else{
-            throw std::runtime_error("Required instance extension " + std::string(layer_name) + " is not available!");
-        }
+template<typename ContainerType>
+void vkutils::find_layer_matches(
+    const std::vector<VkLayerProperties>& aAvailable,
+    const ContainerType& aRequired, const ContainerType& aRequested,
+    std::vector<std::string>& aOutExtList, std::unordered_map<std::string, bool>* aResultMap
+){
+    std::vector<const char*> matches;
+    std::vector<bool> requestedFound;
+    // matches points into the index's copies of the names, so it must outlive the copy into aOutExtList
+    const PropertyNameIndex index(aAvailable);
+    find_layer_matches(index, aRequired, aRequested, matches, &requestedFound);
+    aOutExtList.insert(aOutExtList.end(), matches.begin(), matches.end());
+
+    if(aResultMap != nullptr){
+        size_t i = 0;
+        for(const auto& name : aRequested) aResultMap->operator[](std::string(name)) = requestedFound[i++];
+        for(const auto& name : aRequired) aResultMap->operator[](std::string(name)) = true;
     }
 }
 
@@ -0,0 +1,227 @@
+#include "vkutils.h"
+#include "VmaHost.h"
+#include <cmath>
+
+namespace vkutils{
+
+// Weight of the newest measurement when smoothing member throughput
+static const double sThroughputSmoothing = 0.5;
+
+// Longest dispatch() blocks on one member before checking the others, which bounds their timing error
+static const uint64_t sCompletionCheckIntervalNs = 250000;
+
+ComputeDeviceGroup::ComputeDeviceGroup(
+    const std::vector<VkPhysicalDevice>& aDevices,
+    const std::vector<const char*>& aExtensions,
+    const VkPhysicalDeviceFeatures& aFeatures,
+    VkInstance aInstance,
+    uint32_t aInstanceApiVersion
+){
+    _addMembers(aDevices, aInstance, aInstanceApiVersion, [&](const VulkanPhysicalDevice& aPhysicalDevice){
+        return(aPhysicalDevice.createLogicalDevice(VK_QUEUE_COMPUTE_BIT, aExtensions, aFeatures));
+    });
+}
+
+ComputeDeviceGroup::ComputeDeviceGroup(
+    const std::vector<VkPhysicalDevice>& aDevices,
+    const std::vector<const char*>& aExtensions,
+    const VulkanFeatureChain& aRequired,
+    const VulkanFeatureChain& aRequested,
+    VkInstance aInstance,
+    uint32_t aInstanceApiVersion
+){
+    _addMembers(aDevices, aInstance, aInstanceApiVersion, [&](const VulkanPhysicalDevice& aPhysicalDevice){
+        return(aPhysicalDevice.createLogicalDevice(VK_QUEUE_COMPUTE_BIT, aExtensions, aRequired, aRequested));
+    });
+}
+
+void ComputeDeviceGroup::_addMembers(
+    const std::vector<VkPhysicalDevice>& aDevices,
+    VkInstance aInstance,
+    uint32_t aInstanceApiVersion,
+    const DeviceFactory& aFactory
+){
+    mMembers.reserve(aDevices.size());
+    try{
+        for(VkPhysicalDevice physicalHandle : aDevices){
+            Member member;
+            member.device.physicalDevice = VulkanPhysicalDevice::getSnapshot(physicalHandle, aInstance, aInstanceApiVersion);
+            if(!member.device.physicalDevice.mComputeIdx){
+                std::cerr << "Warning: Skipping device '" << member.device.physicalDevice.mProperties.deviceName << "' without a compute queue" << std::endl;
+                continue;
+            }
+
+            member.computeFamily = *member.device.physicalDevice.mComputeIdx;
+            member.device.logicalDevice = aFactory(member.device.physicalDevice);
+            // Owned by mMembers from here on, so a later failure still destroys the device
+            mMembers.push_back(std::move(member));
+            Member& added = mMembers.back();
+            added.queue = std::make_unique<QueueClosure>(added.device, added.computeFamily, added.device.logicalDevice.getComputeQueue());
+            added.allocator = VmaHost::getAllocator(added.device);
+        }
+    }catch(...){
+        // The destructor does not run for a constructor that throws
+        for(Member& member : mMembers) _destroyMember(member);
+        throw;
+    }
+
+    if(mMembers.empty()) throw std::runtime_error("ComputeDeviceGroup has no usable compute devices!");
+}
+
+ComputeDeviceGroup::~ComputeDeviceGroup(){
+    for(Member& member : mMembers) _destroyMember(member);
+}
+
+void ComputeDeviceGroup::_destroyMember(Member& aMember){
+    // The queue closure waits for outstanding work before it frees its command pools
+    aMember.queue.reset();
+    if(aMember.pipeline.isValid()) aMember.pipeline.destroy(aMember.device.logicalDevice);
+
+    // VmaHost keeps the allocator while pools still hold allocations. Destroying the device under it would
+    // leave VmaHost to free them through a dead device later, so the device is leaked instead.
+    if(!VmaHost::destroyAllocator(aMember.device)){
+        std::cerr << "Warning: Leaking device '" << aMember.device.physicalDevice.mProperties.deviceName
+                  << "', its allocator still has live pool allocations" << std::endl;
+        return;
+    }
+    vkDestroyDevice(aMember.device.logicalDevice, nullptr);
+}
+
+void ComputeDeviceGroup::buildPipeline(
+    const std::string& aSpirvPath,
+    const std::function<void(ComputePipelineConstructionSet&, size_t aMemberIdx)>& aPrepare
+){
+    MappedSpirvFile spirvFile(aSpirvPath);
+    for(size_t i = 0; i < mMembers.size(); ++i){
+        Member& member = mMembers[i];
+        VkDevice device = member.device.logicalDevice;
+
+        VkShaderModule module = create_shader_module(device, spirvFile.words(), spirvFile.size());
+        if(module == VK_NULL_HANDLE) throw std::runtime_error("Failed to create shader module from '" + aSpirvPath + "'!");
+
+        VulkanComputePipelineBuilder builder;
+        VulkanComputePipelineBuilder::prepareUnspecialized(builder.getConstructionSet(), module);
+        if(aPrepare) aPrepare(builder.getConstructionSet(), i);
+
+        if(member.pipeline.isValid()) member.pipeline.destroy(device);
+        try{
+            member.pipeline = builder.build(device);
+        }catch(...){
+            vkDestroyShaderModule(device, module, nullptr);
+            throw;
+        }
+        // The pipeline no longer needs the module once it has been created
+        vkDestroyShaderModule(device, module, nullptr);
+    }
+}
+
+std::vector<ComputeDeviceGroup::Slice> ComputeDeviceGroup::partition(uint32_t aTotal, uint32_t aGranularity) const{
+    aGranularity = std::max(1u, aGranularity);
+    std::vector<double> throughputs = _effectiveThroughputs();
+    double totalThroughput = 0.0;
+    size_t fastest = 0;
+    for(size_t i = 0; i < throughputs.size(); ++i){
+        totalThroughput += throughputs[i];
+        if(throughputs[i] > throughputs[fastest]) fastest = i;
+    }
+
+    std::vector<uint32_t> counts(mMembers.size(), 0);
+    uint32_t assigned = 0;
+    for(size_t i = 0; i < mMembers.size(); ++i){
+        double share = (totalThroughput > 0.0) ? throughputs[i] / totalThroughput : 1.0 / mMembers.size();
+        uint32_t count = static_cast<uint32_t>(std::floor(aTotal * share / aGranularity)) * aGranularity;
+        counts[i] = std::min(count, aTotal - assigned);
+        assigned += counts[i];
+    }
+    // Rounding leftovers go to the last non-empty slice, so every earlier slice stays a multiple of aGranularity.
+    // If rounding left every member empty, the fastest one takes the whole range.
+    size_t leftoverIdx = fastest;
+    for(size_t i = counts.size(); i-- > 0;){
+        if(counts[i] == 0) continue;
+        leftoverIdx = i;
+        break;
+    }
+    counts[leftoverIdx] += aTotal - assigned;
+
+    std::vector<Slice> slices;
+    uint32_t first = 0;
+    for(size_t i = 0; i < mMembers.size(); ++i){
+        if(counts[i] == 0) continue;
+        slices.push_back(Slice{i, first, counts[i]});
+        first += counts[i];
+    }
+    return(slices);
+}
+
+std::vector<double> ComputeDeviceGroup::_effectiveThroughputs() const{
+    double measuredSum = 0.0;
+    size_t measuredCount = 0;
+    for(const Member& member : mMembers){
+        if(member.samples == 0) continue;
+        measuredSum += member.throughput;
+        ++measuredCount;
+    }
+    double average = (measuredCount == 0) ? 1.0 : measuredSum / measuredCount;
+
+    std::vector<double> throughputs;
+    throughputs.reserve(mMembers.size());
+    for(const Member& member : mMembers){
+        throughputs.push_back(member.samples == 0 ? average : member.throughput);
+    }
+    return(throughputs);
+}
+
+std::vector<ComputeDeviceGroup::Slice> ComputeDeviceGroup::dispatch(
+    uint32_t aTotal,
+    const std::function<void(const Slice&, VkCommandBuffer)>& aRecord,
+    const std::function<void(const Slice&)>& aCollect,
+    uint32_t aGranularity
+){
+    std::vector<Slice> slices = partition(aTotal, aGranularity);
+    std::vector<SubmitHandle> handles;
+    handles.reserve(slices.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(const Slice& slice : slices){
+        QueueClosure& queue = *mMembers[slice.member].queue;
+        VkCommandBuffer cmdBuffer = queue.beginOneSubmitCommands();
+        aRecord(slice, cmdBuffer);
+        handles.push_back(queue.finishOneSubmitCommandsAsync(cmdBuffer));
+    }
+
+    // Block on the first unfinished slice for a short interval at a time, then check the others, so each
+    // member's completion time is measured on its own without spinning a core for the whole dispatch
+    std::vector<bool> finished(slices.size(), false);
+    size_t remaining = slices.size();
+    size_t waitIdx = 0;
+    while(remaining > 0){
+        while(finished[waitIdx]) ++waitIdx;
+        VkResult waitResult = handles[waitIdx].wait(sCompletionCheckIntervalNs);
+        if(waitResult != VK_SUCCESS && waitResult != VK_TIMEOUT){
+            throw std::runtime_error("Failed waiting for a ComputeDeviceGroup slice! (" + std::string(vk_result_str(waitResult)) + ")");
+        }
+
+        for(size_t i = 0; i < slices.size(); ++i){
+            if(finished[i] || !handles[i].poll()) continue;
+
+            finished[i] = true;
+            --remaining;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if(seconds <= 0.0) continue;
+
+            Member& member = mMembers[slices[i].member];
+            double measured = slices[i].count / seconds;
+            member.throughput = (member.samples == 0) ? measured : sThroughputSmoothing * measured + (1.0 - sThroughputSmoothing) * member.throughput;
+            ++member.samples;
+        }
+    }
+
+    if(aCollect){
+        for(const Slice& slice : slices){
+            aCollect(slice);
+        }
+    }
+    return(slices);
+}
+
+} // end namespace vkutils
@@ -0,0 +1,102 @@
+/// Spreads compute dispatches across several physical devices.
+///
+/// Every physical device gets its own logical device with a compute queue, a QueueClosure and a VmaHost
+/// allocator. buildPipeline() builds the same compute shader on every member. dispatch() splits a range
+/// of work items into one contiguous slice per member, sized by each member's measured throughput, 
+/// records and submits the slices in parallel, and hands the finished slices back in range order so their
+/// results can be merged. Members start out with equal shares, which are then updated from the wall time of each dispatch.
+class ComputeDeviceGroup
+{
+ public:
+    struct Member
+    {
+        VulkanDeviceBundle device;
+        uint32_t computeFamily = 0;
+        std::unique_ptr<QueueClosure> queue;
+        VmaAllocator allocator = nullptr;
+        VulkanComputePipeline pipeline;
+
+        /// Work items per second, smoothed over previous dispatches. Only meaningful once `samples` is non-zero.
+        double throughput = 0.0;
+        uint32_t samples = 0;
+    };
+
+    /// Range of work items assigned to one member
+    struct Slice
+    {
+        size_t member = 0;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    /// Create a compute device for each entry of aDevices, physical devices of aInstance. Without the instance
+    /// and its API version the devices are limited to Vulkan 1.0.
+    ComputeDeviceGroup(
+        const std::vector<VkPhysicalDevice>& aDevices,
+        const std::vector<const char*>& aExtensions = std::vector<const char*>(),
+        const VkPhysicalDeviceFeatures& aFeatures = {},
+        VkInstance aInstance = VK_NULL_HANDLE,
+        uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+    );
+
+    /// Same as above, with aRequired and aRequested able to enable the 1.1-1.3 feature structs
+    ComputeDeviceGroup(
+        const std::vector<VkPhysicalDevice>& aDevices,
+        const std::vector<const char*>& aExtensions,
+        const VulkanFeatureChain& aRequired,
+        const VulkanFeatureChain& aRequested,
+        VkInstance aInstance = VK_NULL_HANDLE,
+        uint32_t aInstanceApiVersion = VULKAN_DEVICES_DEFAULT_INSTANCE_API_VERSION
+    );
+
+    ~ComputeDeviceGroup();
+
+    ComputeDeviceGroup(const ComputeDeviceGroup&) = delete;
+    ComputeDeviceGroup& operator=(const ComputeDeviceGroup&) = delete;
+
+    size_t size() const {return(mMembers.size());}
+    Member& getMember(size_t aIdx) {return(mMembers[aIdx]);}
+    const Member& getMember(size_t aIdx) const {return(mMembers[aIdx]);}
+
+    /// Build the compute shader at aSpirvPath on every member, replacing any previous pipeline.
+    /// \param aPrepare Called with each member's construction set after the shader stage is bound, to fill
+    ///                 in device specific state such as descriptor set layouts and push constant ranges.
+    void buildPipeline(
+        const std::string& aSpirvPath,
+        const std::function<void(ComputePipelineConstructionSet&, size_t aMemberIdx)>& aPrepare = nullptr
+    );
+
+    /// Split aTotal work items across the members by throughput. Slice sizes are multiples of aGranularity
+    /// except for the last non-empty one. Members given no work are left out.
+    std::vector<Slice> partition(uint32_t aTotal, uint32_t aGranularity = 1) const;
+
+    /// Partition aTotal work items and run them on every member at once.
+    /// \param aRecord Records the work of one slice into a command buffer of the slice's member
+    /// \param aCollect Optional, called for every slice in range order once all slices have completed
+    /// \returns The slices that were dispatched
+    std::vector<Slice> dispatch(
+        uint32_t aTotal,
+        const std::function<void(const Slice&, VkCommandBuffer)>& aRecord,
+        const std::function<void(const Slice&)>& aCollect = nullptr,
+        uint32_t aGranularity = 1
+    );
+
+ protected:
+    using DeviceFactory = std::function<VulkanLogicalDevice(const VulkanPhysicalDevice&)>;
+
+    /// Add a member for each entry of aDevices that has a compute queue, creating its device with aFactory
+    void _addMembers(
+        const std::vector<VkPhysicalDevice>& aDevices,
+        VkInstance aInstance,
+        uint32_t aInstanceApiVersion,
+        const DeviceFactory& aFactory
+    );
+
+    /// Throughput used when partitioning. Members not yet measured are assumed to be average.
+    std::vector<double> _effectiveThroughputs() const;
+
+    /// Release everything a member owns. Members that failed part way through construction are allowed.
+    static void _destroyMember(Member& aMember);
+
+    std::vector<Member> mMembers;
+};
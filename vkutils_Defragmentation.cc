@@ -0,0 +1,311 @@
+#include "vkutils.h"
+#include "VmaHost.h"
+
+namespace vkutils{
+
+DefragmentationService::DefragmentationService(QueueClosure& aQueue, RelocationCallback aCallback, VmaPool aPool)
+: mQueue(aQueue), mDevice(aQueue.getDevicePair().device), mPool(aPool), mCallback(std::move(aCallback))
+{
+    mAllocator = VmaHost::getAllocator(mQueue.getDevicePair());
+    mQueues.push_back(&mQueue);
+}
+
+DefragmentationService::~DefragmentationService(){
+    if(isRunning()) _end();
+}
+
+void DefragmentationService::addQueue(QueueClosure& aQueue){
+    if(aQueue.getDevicePair().device != mDevice){
+        throw std::runtime_error("Defragmentation queues must belong to the device of the allocator!");
+    }
+    mQueues.push_back(&aQueue);
+}
+
+size_t DefragmentationService::_findCopyQueue(VkSharingMode aSharingMode, uint32_t aOwnerFamily) const{
+    if(aSharingMode == VK_SHARING_MODE_CONCURRENT || aOwnerFamily == VK_QUEUE_FAMILY_IGNORED) return(0);
+    for(size_t i = 0; i < mQueues.size(); ++i){
+        if(mQueues[i]->getFamily() == aOwnerFamily) return(i);
+    }
+    throw std::runtime_error("No defragmentation queue for owning family " + std::to_string(aOwnerFamily) + ", add one with addQueue()!");
+}
+
+void DefragmentationService::registerBuffer(
+    VmaAllocation aAllocation,
+    VkBuffer aBuffer,
+    const VkBufferCreateInfo& aCreateInfo,
+    void* aUserData,
+    uint32_t aOwnerFamily
+){
+    const VkBufferUsageFlags transferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if((aCreateInfo.usage & transferUsage) != transferUsage){
+        throw std::runtime_error("Movable buffers must be created with transfer source and destination usage!");
+    }
+    size_t queueIdx = _findCopyQueue(aCreateInfo.sharingMode, aOwnerFamily);
+
+    _Resource& resource = _mResources[aAllocation];
+    resource = _Resource();
+    resource.buffer = aBuffer;
+    resource.bufferInfo = aCreateInfo;
+    resource.bufferInfo.pNext = nullptr;
+    resource.queueFamilies.assign(aCreateInfo.pQueueFamilyIndices, aCreateInfo.pQueueFamilyIndices + aCreateInfo.queueFamilyIndexCount);
+    resource.userData = aUserData;
+    resource.queueIdx = queueIdx;
+}
+
+void DefragmentationService::registerImage(
+    VmaAllocation aAllocation,
+    VkImage aImage,
+    const VkImageCreateInfo& aCreateInfo,
+    VkImageLayout aLayout,
+    VkImageAspectFlags aAspect,
+    void* aUserData,
+    uint32_t aOwnerFamily
+){
+    const VkImageUsageFlags transferUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if((aCreateInfo.usage & transferUsage) != transferUsage){
+        throw std::runtime_error("Movable images must be created with transfer source and destination usage!");
+    }
+    // Leaving either layout discards the contents, and the replacement cannot be transitioned back to them
+    if(aLayout == VK_IMAGE_LAYOUT_UNDEFINED || aLayout == VK_IMAGE_LAYOUT_PREINITIALIZED){
+        throw std::runtime_error("Movable images must be registered with the layout that holds their contents!");
+    }
+    size_t queueIdx = _findCopyQueue(aCreateInfo.sharingMode, aOwnerFamily);
+
+    _Resource& resource = _mResources[aAllocation];
+    resource = _Resource();
+    resource.image = aImage;
+    resource.imageInfo = aCreateInfo;
+    resource.imageInfo.pNext = nullptr;
+    resource.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.queueFamilies.assign(aCreateInfo.pQueueFamilyIndices, aCreateInfo.pQueueFamilyIndices + aCreateInfo.queueFamilyIndexCount);
+    resource.layout = aLayout;
+    resource.aspect = aAspect;
+    resource.userData = aUserData;
+    resource.queueIdx = queueIdx;
+}
+
+void DefragmentationService::unregister(VmaAllocation aAllocation){
+    _mResources.erase(aAllocation);
+}
+
+bool DefragmentationService::step(std::chrono::microseconds aTimeSlice){
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + aTimeSlice;
+    if(!isRunning()) _begin();
+
+    std::vector<_PendingMove> moves;
+    do{
+        VmaDefragmentationPassMoveInfo pass = {};
+        VkResult passResult = vmaBeginDefragmentationPass(mAllocator, _mContext, &pass);
+        if(passResult == VK_SUCCESS){
+            _end();
+            return(true);
+        }
+        if(passResult != VK_INCOMPLETE){
+            _end();
+            throw std::runtime_error("Failed to begin defragmentation pass! (" + std::string(vk_result_str(passResult)) + ")");
+        }
+
+        moves.clear();
+        _runPass(pass, moves);
+
+        // Ending the pass points each moved VmaAllocation at its new memory and frees the old
+        passResult = vmaEndDefragmentationPass(mAllocator, _mContext, &pass);
+        _applyMoves(moves);
+
+        if(passResult == VK_SUCCESS){
+            _end();
+            return(true);
+        }
+    }while(std::chrono::steady_clock::now() < deadline);
+
+    return(false);
+}
+
+void DefragmentationService::_begin(){
+    VmaDefragmentationInfo defragInfo = {};
+    {
+        defragInfo.flags = mAlgorithm;
+        defragInfo.pool = mPool;
+        defragInfo.maxBytesPerPass = mMaxBytesPerPass;
+        defragInfo.maxAllocationsPerPass = mMaxAllocationsPerPass;
+    }
+
+    VkResult beginResult = vmaBeginDefragmentation(mAllocator, &defragInfo, &_mContext);
+    if(beginResult != VK_SUCCESS){
+        _mContext = VK_NULL_HANDLE;
+        throw std::runtime_error("Failed to begin defragmentation! (" + std::string(vk_result_str(beginResult)) + ")");
+    }
+}
+
+void DefragmentationService::_end(){
+    VmaDefragmentationStats runStats = {};
+    vmaEndDefragmentation(mAllocator, _mContext, &runStats);
+    _mContext = VK_NULL_HANDLE;
+
+    mStats.bytesMoved += runStats.bytesMoved;
+    mStats.bytesFreed += runStats.bytesFreed;
+    mStats.allocationsMoved += runStats.allocationsMoved;
+    mStats.deviceMemoryBlocksFreed += runStats.deviceMemoryBlocksFreed;
+}
+
+void DefragmentationService::_runPass(VmaDefragmentationPassMoveInfo& aPass, std::vector<_PendingMove>& aMovesOut){
+    // One command buffer per queue in mQueues, begun on its first copy
+    std::vector<VkCommandBuffer> cmdBuffers(mQueues.size(), VK_NULL_HANDLE);
+
+    for(uint32_t i = 0; i < aPass.moveCount; ++i){
+        VmaDefragmentationMove& move = aPass.pMoves[i];
+        std::unordered_map<VmaAllocation, _Resource>::iterator finder = _mResources.find(move.srcAllocation);
+        if(finder == _mResources.end()){
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        _Resource& resource = finder->second;
+        _PendingMove pending = {move.srcAllocation, VK_NULL_HANDLE, VK_NULL_HANDLE};
+        VkResult createResult;
+        if(resource.buffer != VK_NULL_HANDLE){
+            VkBufferCreateInfo bufferInfo = resource.bufferInfo;
+            bufferInfo.pQueueFamilyIndices = resource.queueFamilies.data();
+            createResult = vkCreateBuffer(mDevice, &bufferInfo, nullptr, &pending.newBuffer);
+            if(createResult == VK_SUCCESS) createResult = vmaBindBufferMemory(mAllocator, move.dstTmpAllocation, pending.newBuffer);
+        }else{
+            VkImageCreateInfo imageInfo = resource.imageInfo;
+            imageInfo.pQueueFamilyIndices = resource.queueFamilies.data();
+            createResult = vkCreateImage(mDevice, &imageInfo, nullptr, &pending.newImage);
+            if(createResult == VK_SUCCESS) createResult = vmaBindImageMemory(mAllocator, move.dstTmpAllocation, pending.newImage);
+        }
+
+        if(createResult != VK_SUCCESS){
+            std::cerr << "Warning: Failed to create replacement for a moved resource, leaving it in place (" << vk_result_str(createResult) << ")" << std::endl;
+            if(pending.newBuffer != VK_NULL_HANDLE) vkDestroyBuffer(mDevice, pending.newBuffer, nullptr);
+            if(pending.newImage != VK_NULL_HANDLE) vkDestroyImage(mDevice, pending.newImage, nullptr);
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        VkCommandBuffer& cmdBuffer = cmdBuffers[resource.queueIdx];
+        if(cmdBuffer == VK_NULL_HANDLE) cmdBuffer = mQueues[resource.queueIdx]->beginOneSubmitCommands();
+        if(pending.newBuffer != VK_NULL_HANDLE){
+            _recordBufferCopy(cmdBuffer, resource, pending.newBuffer);
+        }else{
+            _recordImageCopy(cmdBuffer, resource, pending.newImage);
+        }
+        aMovesOut.push_back(pending);
+    }
+
+    // Every submit is waited for, so no copy is still running once the pass is cancelled below
+    VkResult submitResult = VK_SUCCESS;
+    for(size_t i = 0; i < cmdBuffers.size(); ++i){
+        if(cmdBuffers[i] == VK_NULL_HANDLE) continue;
+        VkResult result = mQueues[i]->finishOneSubmitCommands(cmdBuffers[i]);
+        if(result != VK_SUCCESS) submitResult = result;
+    }
+
+    if(submitResult != VK_SUCCESS){
+        // Nothing can be trusted to have been copied, so cancel every move of the pass
+        std::cerr << "Warning: Defragmentation copies failed, no resources moved (" << vk_result_str(submitResult) << ")" << std::endl;
+        for(uint32_t i = 0; i < aPass.moveCount; ++i) aPass.pMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        for(const _PendingMove& move : aMovesOut){
+            if(move.newBuffer != VK_NULL_HANDLE) vkDestroyBuffer(mDevice, move.newBuffer, nullptr);
+            if(move.newImage != VK_NULL_HANDLE) vkDestroyImage(mDevice, move.newImage, nullptr);
+        }
+        aMovesOut.clear();
+    }
+}
+
+void DefragmentationService::_applyMoves(const std::vector<_PendingMove>& aMoves){
+    for(const _PendingMove& move : aMoves){
+        _Resource& resource = _mResources[move.allocation];
+
+        Relocation relocation;
+        relocation.allocation = move.allocation;
+        relocation.oldBuffer = resource.buffer;
+        relocation.newBuffer = move.newBuffer;
+        relocation.oldImage = resource.image;
+        relocation.newImage = move.newImage;
+        relocation.userData = resource.userData;
+        if(mCallback) mCallback(relocation);
+
+        if(move.newBuffer != VK_NULL_HANDLE){
+            vkDestroyBuffer(mDevice, resource.buffer, nullptr);
+            resource.buffer = move.newBuffer;
+        }else{
+            vkDestroyImage(mDevice, resource.image, nullptr);
+            resource.image = move.newImage;
+        }
+    }
+}
+
+void DefragmentationService::_recordBufferCopy(VkCommandBuffer aCmdBuffer, const _Resource& aResource, VkBuffer aNewBuffer){
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy region = {};
+    region.size = aResource.bufferInfo.size;
+    vkCmdCopyBuffer(aCmdBuffer, aResource.buffer, aNewBuffer, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void DefragmentationService::_recordImageCopy(VkCommandBuffer aCmdBuffer, const _Resource& aResource, VkImage aNewImage){
+    const VkImageCreateInfo& info = aResource.imageInfo;
+
+    // Recorded on a queue of the owning family, so no ownership transfer is needed
+    VkImageMemoryBarrier barriers[2] = {};
+    for(VkImageMemoryBarrier& barrier : barriers){
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = aResource.aspect;
+        barrier.subresourceRange.levelCount = info.mipLevels;
+        barrier.subresourceRange.layerCount = info.arrayLayers;
+    }
+    {
+        barriers[0].image = aResource.image;
+        barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[0].oldLayout = aResource.layout;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        barriers[1].image = aNewImage;
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    }
+    vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+    std::vector<VkImageCopy> regions(info.mipLevels);
+    for(uint32_t mip = 0; mip < info.mipLevels; ++mip){
+        VkImageCopy& region = regions[mip];
+        region = {};
+        region.srcSubresource.aspectMask = aResource.aspect;
+        region.srcSubresource.mipLevel = mip;
+        region.srcSubresource.layerCount = info.arrayLayers;
+        region.dstSubresource = region.srcSubresource;
+        region.extent.width = std::max(1u, info.extent.width >> mip);
+        region.extent.height = std::max(1u, info.extent.height >> mip);
+        region.extent.depth = std::max(1u, info.extent.depth >> mip);
+    }
+    vkCmdCopyImage(
+        aCmdBuffer,
+        aResource.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        aNewImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data()
+    );
+
+    // Leave the replacement in the layout the application expects. The old image is destroyed as it is.
+    VkImageMemoryBarrier& restore = barriers[1];
+    restore.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    restore.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    restore.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    restore.newLayout = aResource.layout;
+    vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &restore);
+}
+
+} // end namespace vkutils
@@ -0,0 +1,148 @@
+
+/// Incremental compaction of the memory behind a VmaHost allocator, or one of its pools.
+///
+/// Resources opt in to being moved with registerBuffer() or registerImage(). Every other allocation is left
+/// where it is. step() runs VMA defragmentation passes until its time slice is used up, so a full compaction
+/// can be spread over many frames. Each pass creates replacement resources bound to the new memory, records
+/// their copies into one transfer command buffer per queue family and waits for them. Each move is then
+/// reported through the relocation callback before the old handle is destroyed.
+///
+/// Copies of VK_SHARING_MODE_EXCLUSIVE resources are recorded on a queue of the family that owns them, so
+/// ownership never has to be transferred and the replacement ends up owned by the same family. Resources
+/// owned by a family other than the constructor's queue need a queue of that family, see addQueue().
+///
+/// Registered resources must not be in use by pending GPU work while step() runs. A service is not
+/// thread-safe, and registration must happen on the thread that calls step().
+class DefragmentationService
+{
+ public:
+    /// One resource moved to new memory
+    struct Relocation
+    {
+        /// Unchanged handle which now refers to the new memory. Mapped pointers must be fetched again.
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkBuffer oldBuffer = VK_NULL_HANDLE;
+        VkBuffer newBuffer = VK_NULL_HANDLE;
+        VkImage oldImage = VK_NULL_HANDLE;
+        VkImage newImage = VK_NULL_HANDLE;
+        void* userData = nullptr;
+    };
+
+    /// Called once per move. Views, descriptors and anything else referring to the old handle must be
+    /// rebuilt against the new one; the old handle is destroyed when the callback returns.
+    using RelocationCallback = std::function<void(const Relocation&)>;
+
+    DefragmentationService(QueueClosure& aQueue, RelocationCallback aCallback, VmaPool aPool = VK_NULL_HANDLE);
+
+    /// Ends a run in progress. Moves already completed are kept.
+    ~DefragmentationService();
+
+    DefragmentationService(const DefragmentationService&) = delete;
+    DefragmentationService& operator=(const DefragmentationService&) = delete;
+
+    /// Record the copies of EXCLUSIVE resources owned by aQueue's family on aQueue. It must belong to the
+    /// same device as the constructor's queue and outlive the service.
+    void addQueue(QueueClosure& aQueue);
+
+    /// Mark aBuffer as movable. It must have been created with TRANSFER_SRC and TRANSFER_DST usage.
+    /// The create info is kept to build the replacement, without its pNext chain.
+    /// \param aOwnerFamily Family owning an EXCLUSIVE buffer whenever step() is called. VK_QUEUE_FAMILY_IGNORED
+    ///                     means the family of the constructor's queue. Unused for CONCURRENT buffers.
+    void registerBuffer(
+        VmaAllocation aAllocation,
+        VkBuffer aBuffer,
+        const VkBufferCreateInfo& aCreateInfo,
+        void* aUserData = nullptr,
+        uint32_t aOwnerFamily = VK_QUEUE_FAMILY_IGNORED
+    );
+
+    /// Mark aImage as movable. It must have been created with TRANSFER_SRC and TRANSFER_DST usage, and be in
+    /// aLayout whenever step() is called. The replacement is left in aLayout as well. aLayout must hold the
+    /// image's contents, so VK_IMAGE_LAYOUT_UNDEFINED and VK_IMAGE_LAYOUT_PREINITIALIZED are rejected.
+    /// \param aOwnerFamily Same as for registerBuffer()
+    void registerImage(
+        VmaAllocation aAllocation,
+        VkImage aImage,
+        const VkImageCreateInfo& aCreateInfo,
+        VkImageLayout aLayout,
+        VkImageAspectFlags aAspect = VK_IMAGE_ASPECT_COLOR_BIT,
+        void* aUserData = nullptr,
+        uint32_t aOwnerFamily = VK_QUEUE_FAMILY_IGNORED
+    );
+
+    /// Must be called before a registered resource is destroyed
+    void unregister(VmaAllocation aAllocation);
+
+    /// Run passes until aTimeSlice has passed or there is nothing left to move. A pass in progress is finished
+    /// before returning, so a slice can overrun by up to one pass; see setPassLimits().
+    /// \returns True if the run is complete
+    bool step(std::chrono::microseconds aTimeSlice);
+
+    /// Bound the work done per pass. Zero means no limit. Takes effect on the next run.
+    void setPassLimits(VkDeviceSize aMaxBytes, uint32_t aMaxAllocations) {mMaxBytesPerPass = aMaxBytes; mMaxAllocationsPerPass = aMaxAllocations;}
+
+    /// VMA_DEFRAGMENTATION_FLAG_ALGORITHM_* bit. Takes effect on the next run.
+    void setAlgorithm(VmaDefragmentationFlags aAlgorithm) {mAlgorithm = aAlgorithm;}
+
+    bool isRunning() const {return(_mContext != VK_NULL_HANDLE);}
+    size_t getRegisteredCount() const {return(_mResources.size());}
+
+    /// Totals across every run that has completed
+    const VmaDefragmentationStats& getStats() const {return(mStats);}
+
+ protected:
+    struct _Resource
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+        VkBufferCreateInfo bufferInfo = {};
+        VkImageCreateInfo imageInfo = {};
+        std::vector<uint32_t> queueFamilies;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageAspectFlags aspect = 0;
+        void* userData = nullptr;
+        // Index into mQueues of the queue the copy is recorded on
+        size_t queueIdx = 0;
+    };
+
+    /// Replacement created for one move of the current pass
+    struct _PendingMove
+    {
+        VmaAllocation allocation;
+        VkBuffer newBuffer;
+        VkImage newImage;
+    };
+
+    void _begin();
+    void _end();
+
+    /// Index into mQueues of the queue to copy a resource on, throws if its owning family has no queue
+    size_t _findCopyQueue(VkSharingMode aSharingMode, uint32_t aOwnerFamily) const;
+
+    /// Create replacements and record and wait for the copies of one pass. Moves of unregistered
+    /// allocations, or whose replacement could not be created, are set to be ignored.
+    void _runPass(VmaDefragmentationPassMoveInfo& aPass, std::vector<_PendingMove>& aMovesOut);
+
+    /// Hand the moves of a finished pass to the callback and destroy the old handles
+    void _applyMoves(const std::vector<_PendingMove>& aMoves);
+
+    void _recordBufferCopy(VkCommandBuffer aCmdBuffer, const _Resource& aResource, VkBuffer aNewBuffer);
+    void _recordImageCopy(VkCommandBuffer aCmdBuffer, const _Resource& aResource, VkImage aNewImage);
+
+    QueueClosure& mQueue;
+    // mQueue first, then every queue given to addQueue()
+    std::vector<QueueClosure*> mQueues;
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VmaAllocator mAllocator = nullptr;
+    VmaPool mPool = VK_NULL_HANDLE;
+    RelocationCallback mCallback;
+
+    VkDeviceSize mMaxBytesPerPass = 64ull * 1024 * 1024;
+    uint32_t mMaxAllocationsPerPass = 64;
+    VmaDefragmentationFlags mAlgorithm = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+    VmaDefragmentationStats mStats = {};
+
+ private:
+    VmaDefragmentationContext _mContext = VK_NULL_HANDLE;
+    std::unordered_map<VmaAllocation, _Resource> _mResources;
+};
@@ -0,0 +1,130 @@
+/// Member pointer and name of one VkBool32 in VkPhysicalDeviceFeatures
+struct PhysicalDeviceFeatureEntry
+{
+    VkBool32 VkPhysicalDeviceFeatures::* member;
+    const char* name;
+};
+
+constexpr size_t sPhysicalDeviceFeatureCount = 55;
+static_assert(sizeof(VkPhysicalDeviceFeatures) == sPhysicalDeviceFeatureCount * sizeof(VkBool32), "VkPhysicalDeviceFeatures layout changed, update sPhysicalDeviceFeatureTable");
+
+/// Every member of VkPhysicalDeviceFeatures in declaration order. Bit i of PhysicalDeviceFeatureBits is entry i.
+inline constexpr std::array<PhysicalDeviceFeatureEntry, sPhysicalDeviceFeatureCount> sPhysicalDeviceFeatureTable = {
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::robustBufferAccess, "robustBufferAccess"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::fullDrawIndexUint32, "fullDrawIndexUint32"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::imageCubeArray, "imageCubeArray"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::independentBlend, "independentBlend"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::geometryShader, "geometryShader"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::tessellationShader, "tessellationShader"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sampleRateShading, "sampleRateShading"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::dualSrcBlend, "dualSrcBlend"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::logicOp, "logicOp"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::multiDrawIndirect, "multiDrawIndirect"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::drawIndirectFirstInstance, "drawIndirectFirstInstance"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::depthClamp, "depthClamp"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::depthBiasClamp, "depthBiasClamp"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::fillModeNonSolid, "fillModeNonSolid"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::depthBounds, "depthBounds"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::wideLines, "wideLines"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::largePoints, "largePoints"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::alphaToOne, "alphaToOne"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::multiViewport, "multiViewport"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::samplerAnisotropy, "samplerAnisotropy"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::textureCompressionETC2, "textureCompressionETC2"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::textureCompressionASTC_LDR, "textureCompressionASTC_LDR"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::textureCompressionBC, "textureCompressionBC"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::occlusionQueryPrecise, "occlusionQueryPrecise"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::pipelineStatisticsQuery, "pipelineStatisticsQuery"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::vertexPipelineStoresAndAtomics, "vertexPipelineStoresAndAtomics"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::fragmentStoresAndAtomics, "fragmentStoresAndAtomics"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderTessellationAndGeometryPointSize, "shaderTessellationAndGeometryPointSize"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderImageGatherExtended, "shaderImageGatherExtended"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderStorageImageExtendedFormats, "shaderStorageImageExtendedFormats"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderStorageImageMultisample, "shaderStorageImageMultisample"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderStorageImageReadWithoutFormat, "shaderStorageImageReadWithoutFormat"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderStorageImageWriteWithoutFormat, "shaderStorageImageWriteWithoutFormat"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderUniformBufferArrayDynamicIndexing, "shaderUniformBufferArrayDynamicIndexing"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderSampledImageArrayDynamicIndexing, "shaderSampledImageArrayDynamicIndexing"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderStorageBufferArrayDynamicIndexing, "shaderStorageBufferArrayDynamicIndexing"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderStorageImageArrayDynamicIndexing, "shaderStorageImageArrayDynamicIndexing"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderClipDistance, "shaderClipDistance"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderCullDistance, "shaderCullDistance"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderFloat64, "shaderFloat64"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderInt64, "shaderInt64"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderInt16, "shaderInt16"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderResourceResidency, "shaderResourceResidency"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::shaderResourceMinLod, "shaderResourceMinLod"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseBinding, "sparseBinding"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseResidencyBuffer, "sparseResidencyBuffer"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseResidencyImage2D, "sparseResidencyImage2D"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseResidencyImage3D, "sparseResidencyImage3D"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseResidency2Samples, "sparseResidency2Samples"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseResidency4Samples, "sparseResidency4Samples"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseResidency8Samples, "sparseResidency8Samples"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseResidency16Samples, "sparseResidency16Samples"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::sparseResidencyAliased, "sparseResidencyAliased"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::variableMultisampleRate, "variableMultisampleRate"},
+    PhysicalDeviceFeatureEntry{&VkPhysicalDeviceFeatures::inheritedQueries, "inheritedQueries"},
+};
+
+/// One bit per VkPhysicalDeviceFeatures member, so set operations on features are a few word-wide operations
+using PhysicalDeviceFeatureBits = std::bitset<sPhysicalDeviceFeatureCount>;
+
+template<typename BinaryOp, size_t... Is>
+inline void _visit_phys_device_features(
+    const VkPhysicalDeviceFeatures& a,
+    const VkPhysicalDeviceFeatures& b,
+    VkPhysicalDeviceFeatures& aFeaturesOut,
+    BinaryOp& aOp,
+    std::index_sequence<Is...>
+){
+    ((aFeaturesOut.*(sPhysicalDeviceFeatureTable[Is].member) = aOp(
+        a.*(sPhysicalDeviceFeatureTable[Is].member),
+        b.*(sPhysicalDeviceFeatureTable[Is].member),
+        sPhysicalDeviceFeatureTable[Is].name
+    )), ...);
+}
+
+/// Applies aOp to each member of `a` and `b`, storing the result in the same member of aFeaturesOut.
+/// Expands to one inlined call per member. aOp is called as `VkBool32(VkBool32 a, VkBool32 b, const char* name)`.
+template<typename BinaryOp>
+inline void visit_phys_device_features(
+    const VkPhysicalDeviceFeatures& a,
+    const VkPhysicalDeviceFeatures& b,
+    VkPhysicalDeviceFeatures& aFeaturesOut,
+    BinaryOp&& aOp
+){
+    _visit_phys_device_features(a, b, aFeaturesOut, aOp, std::make_index_sequence<sPhysicalDeviceFeatureCount>());
+}
+
+/// Unary form of visit_phys_device_features(). aOp is called as `VkBool32(VkBool32 value, const char* name)`.
+template<typename UnaryOp>
+inline void visit_phys_device_features(
+    const VkPhysicalDeviceFeatures& aFeaturesIn,
+    VkPhysicalDeviceFeatures& aFeaturesOut,
+    UnaryOp&& aOp
+){
+    auto binaryOp = [&aOp](VkBool32 aValue, VkBool32, const char* aName) -> VkBool32 {return(aOp(aValue, aName));};
+    _visit_phys_device_features(aFeaturesIn, aFeaturesIn, aFeaturesOut, binaryOp, std::make_index_sequence<sPhysicalDeviceFeatureCount>());
+}
+
+inline PhysicalDeviceFeatureBits features_to_bits(const VkPhysicalDeviceFeatures& aFeatures){
+    PhysicalDeviceFeatureBits bits;
+    for(size_t i = 0; i < sPhysicalDeviceFeatureCount; ++i){
+        bits[i] = aFeatures.*(sPhysicalDeviceFeatureTable[i].member) != VK_FALSE;
+    }
+    return(bits);
+}
+
+inline VkPhysicalDeviceFeatures bits_to_features(const PhysicalDeviceFeatureBits& aBits){
+    VkPhysicalDeviceFeatures features = {};
+    for(size_t i = 0; i < sPhysicalDeviceFeatureCount; ++i){
+        features.*(sPhysicalDeviceFeatureTable[i].member) = aBits[i] ? VK_TRUE : VK_FALSE;
+    }
+    return(features);
+}
+
+/// True if every feature enabled in aSubset is also enabled in aSuperset
+inline bool features_subset_of(const VkPhysicalDeviceFeatures& aSubset, const VkPhysicalDeviceFeatures& aSuperset){
+    return((features_to_bits(aSubset) & ~features_to_bits(aSuperset)).none());
+}
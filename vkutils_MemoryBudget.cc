@@ -0,0 +1,268 @@
+#include "vkutils.h"
+#include "VmaHost.h"
+
+namespace vkutils{
+
+MemoryBudgetMonitor::MemoryBudgetMonitor(const VulkanDeviceHandlePair& aDevicePair, float aHeadroom)
+: mHeadroom(aHeadroom)
+{
+    mAllocator = VmaHost::getAllocator(aDevicePair);
+    vmaGetMemoryProperties(mAllocator, &mMemoryProperties);
+
+    std::lock_guard<std::mutex> lock(_mMutex);
+    _refreshLocked();
+}
+
+void MemoryBudgetMonitor::update(){
+    std::lock_guard<std::mutex> lock(_mMutex);
+    _refreshLocked();
+}
+
+void MemoryBudgetMonitor::_refreshLocked(){
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+    vmaGetHeapBudgets(mAllocator, budgets);
+
+    _mHeaps.resize(mMemoryProperties->memoryHeapCount);
+    for(uint32_t i = 0; i < mMemoryProperties->memoryHeapCount; ++i){
+        HeapBudget& heap = _mHeaps[i];
+        heap.heapIndex = i;
+        heap.deviceLocal = (mMemoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap.usage = budgets[i].usage;
+        heap.budget = budgets[i].budget;
+        heap.blockBytes = budgets[i].statistics.blockBytes;
+        heap.allocationBytes = budgets[i].statistics.allocationBytes;
+    }
+}
+
+std::vector<HeapBudget> MemoryBudgetMonitor::getHeaps() const{
+    std::lock_guard<std::mutex> lock(_mMutex);
+    return(_mHeaps);
+}
+
+bool MemoryBudgetMonitor::isOverBudget(uint32_t aHeapIndex) const{
+    std::lock_guard<std::mutex> lock(_mMutex);
+    return(aHeapIndex < _mHeaps.size() && _mHeaps[aHeapIndex].usage > _limit(_mHeaps[aHeapIndex]));
+}
+
+MemoryBudgetMonitor::EvictableId MemoryBudgetMonitor::registerEvictable(VmaAllocation aAllocation, float aPriority, EvictionCallback aCallback, bool aDemotable){
+    VmaAllocationInfo allocInfo = {};
+    vmaGetAllocationInfo(mAllocator, aAllocation, &allocInfo);
+
+    _Evictable entry;
+    entry.allocation = aAllocation;
+    entry.heapIndex = mMemoryProperties->memoryTypes[allocInfo.memoryType].heapIndex;
+    entry.size = allocInfo.size;
+    entry.priority = aPriority;
+    entry.demotable = aDemotable;
+    entry.callback = std::move(aCallback);
+
+    std::lock_guard<std::mutex> lock(_mMutex);
+    EvictableId id = _mNextId++;
+    _mEvictables.emplace(id, std::move(entry));
+    return(id);
+}
+
+void MemoryBudgetMonitor::unregisterEvictable(EvictableId aId){
+    std::unique_lock<std::mutex> lock(_mMutex);
+    std::unordered_map<EvictableId, _Evictable>::iterator finder = _mEvictables.find(aId);
+    if(finder == _mEvictables.end()) return;
+
+    // Waiting here would deadlock the callback, so let _finishEvictionLocked() drop the entry instead
+    if(finder->second.inFlight && finder->second.evictingThread == std::this_thread::get_id()){
+        finder->second.unregistered = true;
+        return;
+    }
+
+    _mEvictionDone.wait(lock, [this, aId, &finder]() -> bool {
+        finder = _mEvictables.find(aId);
+        return(finder == _mEvictables.end() || !finder->second.inFlight);
+    });
+    if(finder != _mEvictables.end()) _mEvictables.erase(finder);
+}
+
+size_t MemoryBudgetMonitor::getEvictableCount() const{
+    std::lock_guard<std::mutex> lock(_mMutex);
+    return(_mEvictables.size());
+}
+
+void MemoryBudgetMonitor::_selectVictimsLocked(
+    uint32_t aHeapIndex,
+    VkDeviceSize aBytes,
+    float aMaxPriority,
+    std::vector<_Victim>& aVictimsOut,
+    const std::unordered_set<EvictableId>* aSkip
+){
+    std::vector<std::unordered_map<EvictableId, _Evictable>::iterator> candidates;
+    for(std::unordered_map<EvictableId, _Evictable>::iterator iter = _mEvictables.begin(); iter != _mEvictables.end(); ++iter){
+        const _Evictable& entry = iter->second;
+        if(entry.inFlight || entry.heapIndex != aHeapIndex || entry.priority >= aMaxPriority) continue;
+        if(aSkip != nullptr && aSkip->count(iter->first) != 0) continue;
+        candidates.push_back(iter);
+    }
+
+    auto lowerPriority = [](const auto& a, const auto& b) -> bool {return(a->second.priority < b->second.priority);};
+    std::sort(candidates.begin(), candidates.end(), lowerPriority);
+
+    const std::thread::id thisThread = std::this_thread::get_id();
+    VkDeviceSize selectedBytes = 0;
+    for(std::unordered_map<EvictableId, _Evictable>::iterator candidate : candidates){
+        if(selectedBytes >= aBytes) break;
+        _Evictable& entry = candidate->second;
+        selectedBytes += entry.size;
+        entry.inFlight = true;
+        entry.evictingThread = thisThread;
+
+        bool deviceLocal = (mMemoryProperties->memoryHeaps[entry.heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        _Victim victim;
+        victim.id = candidate->first;
+        victim.action = (entry.demotable && deviceLocal) ? EvictionAction::Demote : EvictionAction::Evict;
+        victim.callback = entry.callback;
+        aVictimsOut.push_back(std::move(victim));
+    }
+}
+
+void MemoryBudgetMonitor::_finishEvictionLocked(EvictableId aId, bool aAccepted){
+    std::unordered_map<EvictableId, _Evictable>::iterator finder = _mEvictables.find(aId);
+    if(finder == _mEvictables.end()) return;
+
+    if(aAccepted || finder->second.unregistered){
+        _mEvictables.erase(finder);
+    }else{
+        finder->second.inFlight = false;
+        finder->second.evictingThread = std::thread::id();
+    }
+}
+
+size_t MemoryBudgetMonitor::_evict(std::vector<_Victim>& aVictims){
+    size_t evictedCount = 0;
+    for(size_t i = 0; i < aVictims.size(); ++i){
+        bool accepted = false;
+        try{
+            accepted = aVictims[i].callback(aVictims[i].action);
+        }catch(...){
+            // Release this victim and every one not yet offered before passing the exception on
+            {
+                std::lock_guard<std::mutex> lock(_mMutex);
+                for(size_t j = i; j < aVictims.size(); ++j) _finishEvictionLocked(aVictims[j].id, false);
+            }
+            _mEvictionDone.notify_all();
+            aVictims.clear();
+            throw;
+        }
+
+        if(accepted) ++evictedCount;
+        {
+            std::lock_guard<std::mutex> lock(_mMutex);
+            _finishEvictionLocked(aVictims[i].id, accepted);
+        }
+        _mEvictionDone.notify_all();
+    }
+    aVictims.clear();
+    return(evictedCount);
+}
+
+bool MemoryBudgetMonitor::makeRoom(uint32_t aHeapIndex, VkDeviceSize aBytes, float aMaxPriority){
+    std::vector<_Victim> victims;
+    {
+        std::lock_guard<std::mutex> lock(_mMutex);
+        _refreshLocked();
+        if(aHeapIndex >= _mHeaps.size()) return(false);
+
+        const HeapBudget& heap = _mHeaps[aHeapIndex];
+        const VkDeviceSize limit = _limit(heap);
+        if(heap.usage + aBytes <= limit) return(true);
+        _selectVictimsLocked(aHeapIndex, heap.usage + aBytes - limit, aMaxPriority, victims);
+    }
+
+    if(victims.empty()) return(false);
+    _evict(victims);
+
+    std::lock_guard<std::mutex> lock(_mMutex);
+    _refreshLocked();
+    return(_mHeaps[aHeapIndex].usage + aBytes <= _limit(_mHeaps[aHeapIndex]));
+}
+
+size_t MemoryBudgetMonitor::enforce(){
+    std::vector<_Victim> victims;
+    {
+        std::lock_guard<std::mutex> lock(_mMutex);
+        _refreshLocked();
+        for(const HeapBudget& heap : _mHeaps){
+            const VkDeviceSize limit = _limit(heap);
+            if(heap.usage > limit){
+                _selectVictimsLocked(heap.heapIndex, heap.usage - limit, std::numeric_limits<float>::infinity(), victims);
+            }
+        }
+    }
+
+    size_t evictedCount = _evict(victims);
+
+    std::lock_guard<std::mutex> lock(_mMutex);
+    _refreshLocked();
+    return(evictedCount);
+}
+
+bool MemoryBudgetMonitor::_evictForRetry(uint32_t aHeapIndex){
+    // Offer one candidate at a time, so one refusal doesn't end the retries and the rest of the heap stays
+    // available to other threads while a callback runs
+    std::unordered_set<EvictableId> refused;
+    while(true){
+        std::vector<_Victim> victims;
+        {
+            std::lock_guard<std::mutex> lock(_mMutex);
+            // Registered allocations are never empty, so a single byte selects exactly one candidate
+            _selectVictimsLocked(aHeapIndex, 1, std::numeric_limits<float>::infinity(), victims, &refused);
+        }
+        if(victims.empty()) return(false);
+
+        EvictableId id = victims.front().id;
+        if(_evict(victims) > 0) return(true);
+        refused.insert(id);
+    }
+}
+
+VkResult MemoryBudgetMonitor::createBuffer(
+    const VkBufferCreateInfo& aBufferInfo,
+    const VmaAllocationCreateInfo& aAllocInfo,
+    VkBuffer* aBufferOut,
+    VmaAllocation* aAllocationOut,
+    VmaAllocationInfo* aAllocationInfoOut
+){
+    uint32_t memoryType = 0;
+    if(vmaFindMemoryTypeIndexForBufferInfo(mAllocator, &aBufferInfo, &aAllocInfo, &memoryType) != VK_SUCCESS){
+        return(vmaCreateBuffer(mAllocator, &aBufferInfo, &aAllocInfo, aBufferOut, aAllocationOut, aAllocationInfoOut));
+    }
+
+    const uint32_t heapIndex = mMemoryProperties->memoryTypes[memoryType].heapIndex;
+    makeRoom(heapIndex, aBufferInfo.size);
+
+    VkResult result = vmaCreateBuffer(mAllocator, &aBufferInfo, &aAllocInfo, aBufferOut, aAllocationOut, aAllocationInfoOut);
+    while(result == VK_ERROR_OUT_OF_DEVICE_MEMORY && _evictForRetry(heapIndex)){
+        result = vmaCreateBuffer(mAllocator, &aBufferInfo, &aAllocInfo, aBufferOut, aAllocationOut, aAllocationInfoOut);
+    }
+    return(result);
+}
+
+VkResult MemoryBudgetMonitor::createImage(
+    const VkImageCreateInfo& aImageInfo,
+    const VmaAllocationCreateInfo& aAllocInfo,
+    VkImage* aImageOut,
+    VmaAllocation* aAllocationOut,
+    VmaAllocationInfo* aAllocationInfoOut
+){
+    uint32_t memoryType = 0;
+    if(vmaFindMemoryTypeIndexForImageInfo(mAllocator, &aImageInfo, &aAllocInfo, &memoryType) != VK_SUCCESS){
+        return(vmaCreateImage(mAllocator, &aImageInfo, &aAllocInfo, aImageOut, aAllocationOut, aAllocationInfoOut));
+    }
+
+    const uint32_t heapIndex = mMemoryProperties->memoryTypes[memoryType].heapIndex;
+    makeRoom(heapIndex, 0);
+
+    VkResult result = vmaCreateImage(mAllocator, &aImageInfo, &aAllocInfo, aImageOut, aAllocationOut, aAllocationInfoOut);
+    while(result == VK_ERROR_OUT_OF_DEVICE_MEMORY && _evictForRetry(heapIndex)){
+        result = vmaCreateImage(mAllocator, &aImageInfo, &aAllocInfo, aImageOut, aAllocationOut, aAllocationInfoOut);
+    }
+    return(result);
+}
+
+} // end namespace vkutils
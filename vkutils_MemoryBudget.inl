@@ -0,0 +1,158 @@
+
+/// Usage of one memory heap against its budget, as reported by vmaGetHeapBudgets()
+struct HeapBudget
+{
+    uint32_t heapIndex = 0;
+    bool deviceLocal = false;
+
+    /// Bytes the whole process uses in the heap. Without VK_EXT_memory_budget this is VMA's own blocks only.
+    VkDeviceSize usage = 0;
+
+    /// Bytes the process can use before the driver starts paging. Without VK_EXT_memory_budget VMA estimates it.
+    VkDeviceSize budget = 0;
+
+    /// Bytes of VkDeviceMemory blocks owned by the allocator, and the part of them holding allocations
+    VkDeviceSize blockBytes = 0;
+    VkDeviceSize allocationBytes = 0;
+
+    float pressure() const {return(budget == 0 ? 1.0f : static_cast<float>(usage) / static_cast<float>(budget));}
+};
+
+/// Tracks the heaps of a VmaHost allocator against their budgets and frees memory before allocations fail.
+///
+/// Callers register resources they can do without, each with a priority. When a heap goes over its
+/// headroom, the monitor hands the lowest priority resources in that heap back to their callbacks. A
+/// resource is evicted, or demoted to host-visible memory when it is demotable and lives in a device-local
+/// heap. createBuffer() and createImage() make room before allocating, and evict more and retry if the
+/// allocation still fails with VK_ERROR_OUT_OF_DEVICE_MEMORY.
+///
+/// The allocator reports real budgets when the device was created with VK_EXT_memory_budget; VmaHost enables
+/// it automatically. Safe to use from multiple threads. Callbacks run without the monitor's lock held.
+class MemoryBudgetMonitor
+{
+ public:
+    enum class EvictionAction
+    {
+        Evict,  ///< Release the resource
+        Demote  ///< Move the resource out of device-local memory into host-visible memory
+    };
+
+    /// Performs aAction on one resource. Returning false refuses, and the resource stays registered.
+    /// After returning true the registration is dropped; a demoted resource may register its new allocation.
+    using EvictionCallback = std::function<bool(EvictionAction aAction)>;
+    using EvictableId = uint64_t;
+
+    /// \param aHeadroom Fraction of each heap's budget to keep usage under
+    MemoryBudgetMonitor(const VulkanDeviceHandlePair& aDevicePair, float aHeadroom = 0.9f);
+
+    MemoryBudgetMonitor(const MemoryBudgetMonitor&) = delete;
+    MemoryBudgetMonitor& operator=(const MemoryBudgetMonitor&) = delete;
+
+    /// Refresh the heap budgets from the allocator
+    void update();
+
+    std::vector<HeapBudget> getHeaps() const;
+    bool isOverBudget(uint32_t aHeapIndex) const;
+
+    /// Register a resource the monitor may evict. Higher priorities are evicted last.
+    EvictableId registerEvictable(VmaAllocation aAllocation, float aPriority, EvictionCallback aCallback, bool aDemotable = false);
+
+    /// Must be called before a registered resource is destroyed by its owner. If the resource's callback is
+    /// running on another thread, waits for it to return. Called from within that callback, the registration
+    /// is dropped once the callback returns, whatever it returns.
+    void unregisterEvictable(EvictableId aId);
+
+    /// Evict the lowest priority resources of aHeapIndex until aBytes more fit under the headroom.
+    /// Resources with a priority of aMaxPriority or above are left alone.
+    /// \returns True if aBytes fit afterwards
+    bool makeRoom(uint32_t aHeapIndex, VkDeviceSize aBytes, float aMaxPriority = std::numeric_limits<float>::infinity());
+
+    /// Bring every heap back under the headroom
+    /// \returns Number of resources evicted or demoted
+    size_t enforce();
+
+    /// vmaCreateBuffer() which makes room in the target heap first, and evicts one more resource and retries on
+    /// each VK_ERROR_OUT_OF_DEVICE_MEMORY until nothing in the heap accepts eviction
+    VkResult createBuffer(
+        const VkBufferCreateInfo& aBufferInfo,
+        const VmaAllocationCreateInfo& aAllocInfo,
+        VkBuffer* aBufferOut,
+        VmaAllocation* aAllocationOut,
+        VmaAllocationInfo* aAllocationInfoOut = nullptr
+    );
+
+    /// vmaCreateImage() counterpart of createBuffer(). The image size is not known up front, so room is only
+    /// made for it once an allocation has failed.
+    VkResult createImage(
+        const VkImageCreateInfo& aImageInfo,
+        const VmaAllocationCreateInfo& aAllocInfo,
+        VkImage* aImageOut,
+        VmaAllocation* aAllocationOut,
+        VmaAllocationInfo* aAllocationInfoOut = nullptr
+    );
+
+    size_t getEvictableCount() const;
+    VmaAllocator getAllocator() const {return(mAllocator);}
+    float getHeadroom() const {return(mHeadroom);}
+
+ protected:
+    struct _Evictable
+    {
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        uint32_t heapIndex = 0;
+        VkDeviceSize size = 0;
+        float priority = 0.0f;
+        bool demotable = false;
+        EvictionCallback callback;
+
+        // Set while the callback runs without the lock. The entry stays registered until it returns, so
+        // it is not selected twice and unregisterEvictable() can wait for it.
+        bool inFlight = false;
+        std::thread::id evictingThread;
+        // unregisterEvictable() was called from the callback itself
+        bool unregistered = false;
+    };
+
+    /// Entry selected for eviction, with what is needed to run its callback without the lock
+    struct _Victim
+    {
+        EvictableId id = 0;
+        EvictionAction action = EvictionAction::Evict;
+        EvictionCallback callback;
+    };
+
+    VkDeviceSize _limit(const HeapBudget& aHeap) const {return(static_cast<VkDeviceSize>(static_cast<double>(aHeap.budget) * mHeadroom));}
+    void _refreshLocked();
+
+    /// Mark the lowest priority entries of aHeapIndex totalling at least aBytes in flight. Entries already in
+    /// flight, and those in aSkip, are passed over.
+    void _selectVictimsLocked(
+        uint32_t aHeapIndex,
+        VkDeviceSize aBytes,
+        float aMaxPriority,
+        std::vector<_Victim>& aVictimsOut,
+        const std::unordered_set<EvictableId>* aSkip = nullptr
+    );
+
+    /// Run the victims' callbacks in order. Accepted entries are dropped, refused ones are kept registered.
+    /// \returns Number which were evicted or demoted
+    size_t _evict(std::vector<_Victim>& aVictims);
+
+    /// Drop aId if it was accepted or unregistered by its callback, otherwise clear its in-flight state
+    void _finishEvictionLocked(EvictableId aId, bool aAccepted);
+
+    /// Offer the resources of aHeapIndex one at a time in priority order until one accepts, after a failed allocation
+    bool _evictForRetry(uint32_t aHeapIndex);
+
+    VmaAllocator mAllocator = nullptr;
+    const VkPhysicalDeviceMemoryProperties* mMemoryProperties = nullptr;
+    float mHeadroom = 0.9f;
+
+ private:
+    mutable std::mutex _mMutex;
+    // Signalled whenever an in-flight entry's callback has returned
+    std::condition_variable _mEvictionDone;
+    std::vector<HeapBudget> _mHeaps;
+    std::unordered_map<EvictableId, _Evictable> _mEvictables;
+    EvictableId _mNextId = 1;
+};
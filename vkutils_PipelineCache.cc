@@ -0,0 +1,212 @@
+#include "vkutils.h"
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace vkutils{
+
+// Temporary file name no other process or thread saving to the same path will pick
+static std::string unique_temp_path(const std::string& aPath){
+    static std::atomic<uint64_t> sCounter{0};
+#ifdef _WIN32
+    const long long processId = _getpid();
+#else
+    const long long processId = getpid();
+#endif
+    return(aPath + ".tmp." + std::to_string(processId) + "." + std::to_string(sCounter.fetch_add(1)));
+}
+
+// Write aHeader then aData to aPath and flush both to the storage device before returning
+static bool write_file_synced(const std::string& aPath, const std::vector<uint8_t>& aHeader, const std::vector<char>& aData){
+    FILE* file = std::fopen(aPath.c_str(), "wb");
+    if(file == nullptr) return(false);
+
+    bool written = 
+        std::fwrite(aHeader.data(), 1, aHeader.size(), file) == aHeader.size() &&
+        std::fwrite(aData.data(), 1, aData.size(), file) == aData.size() &&
+        std::fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    return((std::fclose(file) == 0) && written);
+}
+
+PipelineCache::PipelineCache(const VulkanDeviceHandlePair& aDevicePair, const std::string& aCachePath)
+: mDevicePair(aDevicePair), mPath(aCachePath)
+{
+    vkGetPhysicalDeviceProperties(mDevicePair.physicalDevice, &mDeviceProperties);
+
+    std::vector<char> initialData;
+    if(!mPath.empty()) initialData = _loadValidatedBlob(mPath);
+    mLoadedFromDisk = !initialData.empty();
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.pNext = nullptr;
+        createInfo.flags = 0;
+        createInfo.initialDataSize = initialData.size();
+        createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+    }
+
+    VkResult createResult = vkCreatePipelineCache(mDevicePair.device, &createInfo, nullptr, &mCache);
+    if(createResult != VK_SUCCESS && mLoadedFromDisk){
+        // The driver may still reject a blob that passed validation, in which case start empty
+        std::cerr << "Warning: Driver rejected pipeline cache data from \"" << mPath << "\" (" << vk_result_str(createResult) << ")" << std::endl;
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        mLoadedFromDisk = false;
+        createResult = vkCreatePipelineCache(mDevicePair.device, &createInfo, nullptr, &mCache);
+    }
+    if(createResult != VK_SUCCESS){
+        throw std::runtime_error("Failed to create pipeline cache! (" + std::string(vk_result_str(createResult)) + ")");
+    }
+}
+
+bool PipelineCache::save(const std::string& aCachePath) const{
+    const std::string& path = aCachePath.empty() ? mPath : aCachePath;
+    if(!isValid() || path.empty()) return(false);
+
+    size_t dataSize = 0;
+    if(vkGetPipelineCacheData(mDevicePair.device, mCache, &dataSize, nullptr) != VK_SUCCESS){
+        std::cerr << "Warning: Unable to query pipeline cache size" << std::endl;
+        return(false);
+    }
+    std::vector<char> data(dataSize);
+    VkResult dataResult = vkGetPipelineCacheData(mDevicePair.device, mCache, &dataSize, data.data());
+    if(dataResult != VK_SUCCESS){
+        std::cerr << "Warning: Unable to read pipeline cache data (" << vk_result_str(dataResult) << ")" << std::endl;
+        return(false);
+    }
+    data.resize(dataSize);
+
+    std::vector<uint8_t> headerBytes(_sFileHeaderSize);
+    _writeFileHeader(_makeFileHeader(data.size()), headerBytes.data());
+
+    std::string tempPath = unique_temp_path(path);
+    if(!write_file_synced(tempPath, headerBytes, data)){
+        std::cerr << "Warning: Failed to write pipeline cache to \"" << tempPath << "\"" << std::endl;
+        std::remove(tempPath.c_str());
+        return(false);
+    }
+
+    // rename() replaces the target atomically on POSIX. Windows refuses to replace, so clear the target and retry.
+    if(std::rename(tempPath.c_str(), path.c_str()) != 0){
+        std::remove(path.c_str());
+        if(std::rename(tempPath.c_str(), path.c_str()) != 0){
+            std::cerr << "Warning: Failed to move pipeline cache into place at \"" << path << "\"" << std::endl;
+            std::remove(tempPath.c_str());
+            return(false);
+        }
+    }
+    return(true);
+}
+
+void PipelineCache::destroy(){
+    if(!isValid()) return;
+    if(!mPath.empty()) save();
+    vkDestroyPipelineCache(mDevicePair.device, mCache, nullptr);
+    mCache = VK_NULL_HANDLE;
+}
+
+std::vector<char> PipelineCache::_loadValidatedBlob(const std::string& aCachePath) const{
+    std::ifstream inFile(aCachePath, std::ios::binary | std::ios::ate);
+    if(!inFile.is_open()) return(std::vector<char>());
+
+    const size_t fileSize = static_cast<size_t>(inFile.tellg());
+    inFile.seekg(0);
+
+    uint8_t headerBytes[_sFileHeaderSize];
+    if(fileSize < _sFileHeaderSize || !inFile.read(reinterpret_cast<char*>(headerBytes), _sFileHeaderSize)){
+        std::cerr << "Warning: Ignoring truncated pipeline cache \"" << aCachePath << "\"" << std::endl;
+        return(std::vector<char>());
+    }
+
+    _FileHeader header = _readFileHeader(headerBytes);
+    _FileHeader expected = _makeFileHeader(fileSize - _sFileHeaderSize);
+    bool headerMatches = 
+        header.magic == expected.magic &&
+        header.version == expected.version &&
+        header.vendorID == expected.vendorID &&
+        header.deviceID == expected.deviceID &&
+        header.driverVersion == expected.driverVersion &&
+        header.dataSize == expected.dataSize &&
+        std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    if(!headerMatches){
+        std::cerr << "Warning: Ignoring pipeline cache \"" << aCachePath << "\" created for a different device or driver" << std::endl;
+        return(std::vector<char>());
+    }
+
+    std::vector<char> blob(static_cast<size_t>(header.dataSize));
+    if(!inFile.read(blob.data(), static_cast<std::streamsize>(blob.size()))) return(std::vector<char>());
+
+    // The driver's own header must agree with the prefix as well
+    VkPipelineCacheHeaderVersionOne blobHeader = {};
+    if(blob.size() < sizeof(blobHeader)) return(std::vector<char>());
+    std::memcpy(&blobHeader, blob.data(), sizeof(blobHeader));
+    bool blobMatches = 
+        blobHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        blobHeader.vendorID == mDeviceProperties.vendorID &&
+        blobHeader.deviceID == mDeviceProperties.deviceID &&
+        std::memcmp(blobHeader.pipelineCacheUUID, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    if(!blobMatches){
+        std::cerr << "Warning: Ignoring pipeline cache \"" << aCachePath << "\" with mismatched driver header" << std::endl;
+        return(std::vector<char>());
+    }
+
+    return(blob);
+}
+
+PipelineCache::_FileHeader PipelineCache::_makeFileHeader(uint64_t aDataSize) const{
+    _FileHeader header = {};
+    header.magic = _sFileMagic;
+    header.version = _sFileVersion;
+    header.vendorID = mDeviceProperties.vendorID;
+    header.deviceID = mDeviceProperties.deviceID;
+    header.driverVersion = mDeviceProperties.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = aDataSize;
+    return(header);
+}
+
+void PipelineCache::_writeFileHeader(const _FileHeader& aHeader, uint8_t* aBytesOut){
+    auto put = [&aBytesOut](uint64_t aValue, size_t aSize){
+        for(size_t i = 0; i < aSize; ++i) *aBytesOut++ = static_cast<uint8_t>(aValue >> (8 * i));
+    };
+    put(aHeader.magic, sizeof(uint32_t));
+    put(aHeader.version, sizeof(uint32_t));
+    put(aHeader.vendorID, sizeof(uint32_t));
+    put(aHeader.deviceID, sizeof(uint32_t));
+    put(aHeader.driverVersion, sizeof(uint32_t));
+    std::memcpy(aBytesOut, aHeader.pipelineCacheUUID, VK_UUID_SIZE);
+    aBytesOut += VK_UUID_SIZE;
+    put(aHeader.dataSize, sizeof(uint64_t));
+}
+
+PipelineCache::_FileHeader PipelineCache::_readFileHeader(const uint8_t* aBytes){
+    auto get = [&aBytes](size_t aSize) -> uint64_t {
+        uint64_t value = 0;
+        for(size_t i = 0; i < aSize; ++i) value |= static_cast<uint64_t>(*aBytes++) << (8 * i);
+        return(value);
+    };
+    _FileHeader header = {};
+    header.magic = static_cast<uint32_t>(get(sizeof(uint32_t)));
+    header.version = static_cast<uint32_t>(get(sizeof(uint32_t)));
+    header.vendorID = static_cast<uint32_t>(get(sizeof(uint32_t)));
+    header.deviceID = static_cast<uint32_t>(get(sizeof(uint32_t)));
+    header.driverVersion = static_cast<uint32_t>(get(sizeof(uint32_t)));
+    std::memcpy(header.pipelineCacheUUID, aBytes, VK_UUID_SIZE);
+    aBytes += VK_UUID_SIZE;
+    header.dataSize = get(sizeof(uint64_t));
+    return(header);
+}
+
+} // end namespace vkutils
@@ -0,0 +1,71 @@
+/// VkPipelineCache which persists across runs in a file on disk.
+///
+/// The file holds a small prefix identifying the device and driver that produced the blob, followed by the
+/// data returned from vkGetPipelineCacheData(). A blob is only handed to the driver when the prefix and the
+/// Vulkan cache header both match the current vendorID, deviceID, driverVersion and pipelineCacheUUID;
+/// anything else starts an empty cache. Saving writes a uniquely named temporary file next to the target, 
+/// flushes it to disk and renames it into place, so neither a crash mid-write nor several processes saving
+/// at once leave a truncated cache behind.
+///
+/// The cache handle may be shared by pipeline builds on any number of threads.
+class PipelineCache
+{
+ public:
+    PipelineCache(){}
+
+    /// Create the cache, seeding it from `aCachePath` when the file exists and is valid for this device.
+    /// An empty path creates an in-memory cache which is never written to disk.
+    PipelineCache(const VulkanDeviceHandlePair& aDevicePair, const std::string& aCachePath = std::string());
+
+    /// Saves the cache to its path (if any) before destroying it
+    ~PipelineCache(){destroy();}
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    VkPipelineCache handle() const {return(mCache);}
+    bool isValid() const {return(mCache != VK_NULL_HANDLE);}
+    const std::string& getPath() const {return(mPath);}
+
+    /// True if the cache was seeded from a valid file on disk
+    bool wasLoadedFromDisk() const {return(mLoadedFromDisk);}
+
+    /// Write the current cache contents to `aCachePath`, or the path given at construction when empty.
+    /// \returns false with a warning on stderr if the data could not be written.
+    bool save(const std::string& aCachePath = std::string()) const;
+
+    /// Save to the cache path (if any) and destroy the cache
+    void destroy();
+
+    operator VkPipelineCache() const {return(mCache);}
+
+ protected:
+    /// Prefix written ahead of the driver's cache blob
+    struct _FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    static constexpr uint32_t _sFileMagic = 0x43505556; // "VUPC"
+    static constexpr uint32_t _sFileVersion = 2;
+
+    /// The header is written field by field in little endian order, with no padding
+    static constexpr size_t _sFileHeaderSize = 5 * sizeof(uint32_t) + VK_UUID_SIZE + sizeof(uint64_t);
+    static void _writeFileHeader(const _FileHeader& aHeader, uint8_t* aBytesOut);
+    static _FileHeader _readFileHeader(const uint8_t* aBytes);
+
+    std::vector<char> _loadValidatedBlob(const std::string& aCachePath) const;
+    _FileHeader _makeFileHeader(uint64_t aDataSize) const;
+
+    VulkanDeviceHandlePair mDevicePair;
+    VkPhysicalDeviceProperties mDeviceProperties = {};
+    VkPipelineCache mCache = VK_NULL_HANDLE;
+    std::string mPath;
+    bool mLoadedFromDisk = false;
+};
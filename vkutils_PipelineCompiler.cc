@@ -0,0 +1,163 @@
+#include "vkutils.h"
+
+namespace vkutils{
+
+static const char* sCompilerCancelledMsg = "Pipeline compiler was destroyed before this entry ran";
+
+PipelineCompiler::PipelineCompiler(VkPipelineCache aSharedCache, size_t aWorkerCount)
+: mSharedCache(aSharedCache)
+{
+    if(aWorkerCount == 0) aWorkerCount = std::max(1u, std::thread::hardware_concurrency());
+    _mWorkers.reserve(aWorkerCount);
+    for(size_t i = 0; i < aWorkerCount; ++i){
+        _mWorkers.emplace_back(&PipelineCompiler::_workerLoop, this);
+    }
+}
+
+PipelineCompiler::~PipelineCompiler(){
+    std::priority_queue<_Task> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(_mTaskMutex);
+        _mStopping = true;
+        abandoned.swap(_mTasks);
+    }
+    _mTaskCondition.notify_all();
+    for(std::thread& worker : _mWorkers){
+        worker.join();
+    }
+
+    while(!abandoned.empty()){
+        _runTask(abandoned.top().run, true);
+        abandoned.pop();
+    }
+}
+
+std::vector<PipelineBuildResult<VulkanComputePipeline>> PipelineCompiler::buildCompute(
+    VkDevice aLogicalDevice,
+    const std::vector<ComputePipelineConstructionSet>& aCtorSets
+){
+    PipelineBuildResult<VulkanComputePipeline> cancelled;
+    cancelled.error = sCompilerCancelledMsg;
+    std::vector<PipelineBuildResult<VulkanComputePipeline>> results(aCtorSets.size(), cancelled);
+    _runBatch(aCtorSets.size(), [&](size_t aIdx){
+        results[aIdx] = buildOne(aLogicalDevice, aCtorSets[aIdx]);
+    });
+    return(results);
+}
+
+std::vector<PipelineBuildResult<VulkanRenderPipeline>> PipelineCompiler::buildGraphics(
+    const std::vector<GraphicsPipelineConstructionSet>& aCtorSets
+){
+    PipelineBuildResult<VulkanRenderPipeline> cancelled;
+    cancelled.error = sCompilerCancelledMsg;
+    std::vector<PipelineBuildResult<VulkanRenderPipeline>> results(aCtorSets.size(), cancelled);
+    _runBatch(aCtorSets.size(), [&](size_t aIdx){
+        results[aIdx] = buildOne(aCtorSets[aIdx]);
+    });
+    return(results);
+}
+
+PipelineBuildResult<VulkanComputePipeline> PipelineCompiler::buildOne(VkDevice aLogicalDevice, const ComputePipelineConstructionSet& aCtorSet) const{
+    PipelineBuildResult<VulkanComputePipeline> result;
+    try{
+        VulkanComputePipelineBuilder builder(aCtorSet);
+        if(builder.getConstructionSet().mPipelineCache == VK_NULL_HANDLE) builder.getConstructionSet().mPipelineCache = mSharedCache;
+        result.pipeline = builder.build(aLogicalDevice);
+    }catch(const std::exception& e){
+        result.error = e.what();
+    }
+    return(result);
+}
+
+PipelineBuildResult<VulkanRenderPipeline> PipelineCompiler::buildOne(const GraphicsPipelineConstructionSet& aCtorSet) const{
+    PipelineBuildResult<VulkanRenderPipeline> result;
+    try{
+        GraphicsPipelineConstructionSet ctorSet = aCtorSet;
+        if(ctorSet.mPipelineCache == VK_NULL_HANDLE) ctorSet.mPipelineCache = mSharedCache;
+
+        VulkanBasicRasterPipelineBuilder builder(ctorSet.mDevicePair, ctorSet.mSwapchainBundle);
+        builder.build(ctorSet);
+        result.pipeline = builder;
+    }catch(const std::exception& e){
+        result.error = e.what();
+    }
+    return(result);
+}
+
+void PipelineCompiler::enqueue(int aPriority, Task aTask){
+    {
+        std::lock_guard<std::mutex> lock(_mTaskMutex);
+        _mTasks.push(_Task{aPriority, _mNextSequence++, std::move(aTask)});
+    }
+    _mTaskCondition.notify_one();
+}
+
+bool PipelineCompiler::_isWorkerThread() const{
+    const std::thread::id thisThread = std::this_thread::get_id();
+    return(std::any_of(_mWorkers.begin(), _mWorkers.end(), [&](const std::thread& aWorker){return(aWorker.get_id() == thisThread);}));
+}
+
+void PipelineCompiler::_runTask(const Task& aTask, bool aCancelled){
+    // A task's exception has nowhere to go on a worker, so report it rather than terminate
+    try{
+        aTask(aCancelled);
+    }catch(const std::exception& e){
+        std::cerr << "Warning: Pipeline compiler task threw an exception: " << e.what() << std::endl;
+    }catch(...){
+        std::cerr << "Warning: Pipeline compiler task threw an unknown exception" << std::endl;
+    }
+}
+
+void PipelineCompiler::_runBatch(size_t aCount, const std::function<void(size_t)>& aBuildOne){
+    if(aCount == 0) return;
+
+    // Waiting on the workers from one of them would deadlock once every worker does it, so build inline
+    if(_isWorkerThread()){
+        for(size_t i = 0; i < aCount; ++i) aBuildOne(i);
+        return;
+    }
+
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    size_t remaining = aCount;
+
+    {
+        std::lock_guard<std::mutex> lock(_mTaskMutex);
+        for(size_t i = 0; i < aCount; ++i){
+            _mTasks.push(_Task{sBatchPriority, _mNextSequence++, [&, i](bool aCancelled){
+                auto finish = [&](){
+                    std::lock_guard<std::mutex> doneLock(doneMutex);
+                    if(--remaining == 0) doneCondition.notify_one();
+                };
+                // The entry keeps its cancelled result if the builder throws something other than std::exception
+                try{
+                    if(!aCancelled) aBuildOne(i);
+                }catch(...){
+                    finish();
+                    throw;
+                }
+                finish();
+            }});
+        }
+    }
+    _mTaskCondition.notify_all();
+
+    std::unique_lock<std::mutex> doneLock(doneMutex);
+    doneCondition.wait(doneLock, [&](){return(remaining == 0);});
+}
+
+void PipelineCompiler::_workerLoop(){
+    while(true){
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(_mTaskMutex);
+            _mTaskCondition.wait(lock, [this](){return(_mStopping || !_mTasks.empty());});
+            if(_mStopping) return;
+            task = _mTasks.top().run;
+            _mTasks.pop();
+        }
+        _runTask(task, false);
+    }
+}
+
+} // end namespace vkutils
@@ -0,0 +1,91 @@
+/// Outcome of building one entry of a pipeline batch. On failure `pipeline` is invalid and `error` holds the
+/// message of the exception thrown by the builder.
+template<typename PipelineType>
+struct PipelineBuildResult
+{
+    PipelineType pipeline;
+    std::string error;
+
+    bool isValid() const {return(error.empty() && pipeline.isValid());}
+};
+
+/// Builds batches of render and compute pipelines on a pool of worker threads.
+///
+/// Every entry is built with its own builder on whichever worker picks it up. Entries which do not name a
+/// pipeline cache in their construction set use the compiler's shared cache, so the driver can reuse work
+/// across the whole batch and across batches. The batch calls block until every entry has finished, and
+/// one failing entry does not stop the rest of the batch. Other work, such as PipelineWarmup's, can be
+/// queued on the same workers with enqueue().
+class PipelineCompiler
+{
+ public:
+    /// Priority of the entries of blocking batch calls, which run ahead of every enqueued task
+    static constexpr int sBatchPriority = std::numeric_limits<int>::max();
+
+    /// Called with true instead of being run when the compiler is destroyed first. Exceptions escaping a task
+    /// are reported on std::cerr and otherwise dropped.
+    using Task = std::function<void(bool aCancelled)>;
+
+    /// \param aSharedCache Cache used by entries without their own, e.g. PipelineCache::handle()
+    /// \param aWorkerCount Number of worker threads. Zero uses std::thread::hardware_concurrency().
+    PipelineCompiler(VkPipelineCache aSharedCache = VK_NULL_HANDLE, size_t aWorkerCount = 0);
+
+    /// Tasks which have not started are called as cancelled
+    ~PipelineCompiler();
+
+    PipelineCompiler(const PipelineCompiler&) = delete;
+    PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+    size_t getWorkerCount() const {return(_mWorkers.size());}
+    VkPipelineCache getSharedCache() const {return(mSharedCache);}
+
+    /// Build every compute pipeline in `aCtorSets` on `aLogicalDevice`. Results are in the same order as the input.
+    /// Called from an enqueued task, the batch is built on the calling worker instead, so waiting on the
+    /// other workers cannot deadlock the pool.
+    std::vector<PipelineBuildResult<VulkanComputePipeline>> buildCompute(
+        VkDevice aLogicalDevice,
+        const std::vector<ComputePipelineConstructionSet>& aCtorSets
+    );
+
+    /// Build every graphics pipeline in `aCtorSets`. Each set supplies its own device and swapchain bundle.
+    /// Results are in the same order as the input. Runs inline when called from a worker, as buildCompute() does.
+    std::vector<PipelineBuildResult<VulkanRenderPipeline>> buildGraphics(
+        const std::vector<GraphicsPipelineConstructionSet>& aCtorSets
+    );
+
+    /// Build one pipeline on the calling thread, using the shared cache if the set names none
+    PipelineBuildResult<VulkanComputePipeline> buildOne(VkDevice aLogicalDevice, const ComputePipelineConstructionSet& aCtorSet) const;
+    PipelineBuildResult<VulkanRenderPipeline> buildOne(const GraphicsPipelineConstructionSet& aCtorSet) const;
+
+    /// Queue aTask without waiting for it. Workers take the highest priority task first, and tasks of equal
+    /// priority in the order they were queued.
+    void enqueue(int aPriority, Task aTask);
+
+ protected:
+    struct _Task
+    {
+        int priority;
+        uint64_t sequence;
+        Task run;
+
+        bool operator<(const _Task& aOther) const {
+            return(priority != aOther.priority ? priority < aOther.priority : sequence > aOther.sequence);
+        }
+    };
+
+    /// Run aBuildOne(i) for i in [0, aCount) across the workers and wait for all of them
+    void _runBatch(size_t aCount, const std::function<void(size_t)>& aBuildOne);
+    void _workerLoop();
+    bool _isWorkerThread() const;
+    static void _runTask(const Task& aTask, bool aCancelled);
+
+    VkPipelineCache mSharedCache = VK_NULL_HANDLE;
+
+ private:
+    std::mutex _mTaskMutex;
+    std::condition_variable _mTaskCondition;
+    std::priority_queue<_Task> _mTasks;
+    uint64_t _mNextSequence = 0;
+    std::vector<std::thread> _mWorkers;
+    bool _mStopping = false;
+};
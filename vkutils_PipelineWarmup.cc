@@ -0,0 +1,136 @@
+#include "vkutils.h"
+
+namespace vkutils{
+
+static const char* sWarmupCancelledMsg = "Pipeline warm-up was destroyed before this entry ran";
+
+bool PipelineWarmup::Handle::poll() const{
+    if(_mState == nullptr) return(true);
+    std::lock_guard<std::mutex> lock(_mState->mutex);
+    return(_mState->completed == _mState->total);
+}
+
+void PipelineWarmup::Handle::wait() const{
+    if(_mState == nullptr) return;
+    std::unique_lock<std::mutex> lock(_mState->mutex);
+    _mState->condition.wait(lock, [this](){return(_mState->completed == _mState->total);});
+}
+
+bool PipelineWarmup::Handle::waitFor(std::chrono::milliseconds aTimeout) const{
+    if(_mState == nullptr) return(true);
+    std::unique_lock<std::mutex> lock(_mState->mutex);
+    return(_mState->condition.wait_for(lock, aTimeout, [this](){return(_mState->completed == _mState->total);}));
+}
+
+size_t PipelineWarmup::Handle::getCompletedCount() const{
+    if(_mState == nullptr) return(0);
+    std::lock_guard<std::mutex> lock(_mState->mutex);
+    return(_mState->completed);
+}
+
+size_t PipelineWarmup::Handle::getTotalCount() const{
+    return(_mState == nullptr ? 0 : _mState->total);
+}
+
+const PipelineWarmup::Results& PipelineWarmup::Handle::getResults() const{
+    if(_mState == nullptr) throw std::runtime_error("Attempted to read results of an invalid warm-up handle!");
+    wait();
+    return(_mState->results);
+}
+
+PipelineWarmup::PipelineWarmup(ShaderModuleCache& aShaderCache, VkPipelineCache aSharedCache, size_t aWorkerCount)
+: mShaderCache(aShaderCache), mCompiler(aSharedCache, aWorkerCount)
+{}
+
+PipelineWarmup::Handle PipelineWarmup::start(const Manifest& aManifest){
+    std::shared_ptr<_State> state = std::make_shared<_State>();
+    state->total = aManifest.shaders.size() + aManifest.compute.size() + aManifest.graphics.size();
+    state->results.shaders.resize(aManifest.shaders.size());
+    state->results.shaderErrors.resize(aManifest.shaders.size());
+    state->results.compute.resize(aManifest.compute.size());
+    state->results.graphics.resize(aManifest.graphics.size());
+    state->computeShaders.resize(aManifest.compute.size());
+
+    // Each task writes only its own result slot, so results need no lock until the handle reports completion
+    for(size_t i = 0; i < aManifest.shaders.size(); ++i){
+        std::string path = aManifest.shaders[i].path;
+        mCompiler.enqueue(aManifest.shaders[i].priority, [this, state, i, path](bool aCancelled){
+            if(aCancelled){
+                state->results.shaderErrors[i] = sWarmupCancelledMsg;
+            }else{
+                try{
+                    state->results.shaders[i] = mShaderCache.load(path);
+                    if(state->results.shaders[i] == nullptr) state->results.shaderErrors[i] = "Failed to create shader module from '" + path + "'!";
+                }catch(const std::exception& e){
+                    state->results.shaderErrors[i] = e.what();
+                }
+            }
+            _markComplete(*state);
+        });
+    }
+
+    for(size_t i = 0; i < aManifest.compute.size(); ++i){
+        ComputeEntry entry = aManifest.compute[i];
+        mCompiler.enqueue(entry.priority, [this, state, i, entry](bool aCancelled) mutable{
+            PipelineBuildResult<VulkanComputePipeline>& result = state->results.compute[i];
+            if(aCancelled){
+                result.error = sWarmupCancelledMsg;
+            }else if(_bindCachedShader(entry, state->computeShaders[i], result.error)){
+                result = mCompiler.buildOne(mShaderCache.getDevice(), entry.ctorSet);
+            }
+            _markComplete(*state);
+        });
+    }
+
+    for(size_t i = 0; i < aManifest.graphics.size(); ++i){
+        GraphicsPipelineConstructionSet ctorSet = aManifest.graphics[i].ctorSet;
+        mCompiler.enqueue(aManifest.graphics[i].priority, [this, state, i, ctorSet](bool aCancelled){
+            PipelineBuildResult<VulkanRenderPipeline>& result = state->results.graphics[i];
+            if(aCancelled){
+                result.error = sWarmupCancelledMsg;
+            }else{
+                result = mCompiler.buildOne(ctorSet);
+            }
+            _markComplete(*state);
+        });
+    }
+
+    return(Handle(state));
+}
+
+bool PipelineWarmup::_bindCachedShader(ComputeEntry& aEntry, SharedShaderModule& aModuleOut, std::string& aErrorOut){
+    if(aEntry.shaderPath.empty()) return(true);
+    try{
+        aModuleOut = mShaderCache.load(aEntry.shaderPath);
+    }catch(const std::exception& e){
+        aErrorOut = e.what();
+        return(false);
+    }
+    if(aModuleOut == nullptr){
+        aErrorOut = "Failed to create shader module from '" + aEntry.shaderPath + "'!";
+        return(false);
+    }
+
+    // Only the module changes. The caller's layout, entry point and specialization info are kept.
+    VkPipelineShaderStageCreateInfo& stage = aEntry.ctorSet.mComputePipelineInfo.stage;
+    if(stage.sType != VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO){
+        stage = {};
+        stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        stage.pName = "main";
+    }
+    stage.module = aModuleOut->module;
+    aEntry.ctorSet.mComputePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    aEntry.ctorSet.mLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    return(true);
+}
+
+void PipelineWarmup::_markComplete(_State& aState){
+    {
+        std::lock_guard<std::mutex> lock(aState.mutex);
+        ++aState.completed;
+    }
+    aState.condition.notify_all();
+}
+
+} // end namespace vkutils
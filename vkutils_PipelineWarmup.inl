@@ -0,0 +1,118 @@
+/// Compiles shaders and pipelines ahead of first use on background threads.
+///
+/// A manifest lists shader files and pipeline construction sets, each with a priority. start() queues 
+/// every entry and returns immediately with a handle that can be polled or waited on. Entries run as tasks
+/// of an internal PipelineCompiler, whose workers always pick the highest priority entry left across all
+/// started manifests, with ties taken in manifest order. Shaders go through the given ShaderModuleCache,
+/// so a later load of the same file is a cache hit, and pipelines share one pipeline cache.
+class PipelineWarmup
+{
+ public:
+    struct ShaderEntry
+    {
+        std::string path;
+        int priority = 0;
+    };
+
+    /// When `shaderPath` is set its module is loaded through the shader cache and replaces the module of
+    /// `ctorSet.mComputePipelineInfo.stage` before building. The layout, entry point and specialization info of
+    /// the construction set are kept; a stage which was never filled in gets the "main" compute entry point.
+    struct ComputeEntry
+    {
+        ComputePipelineConstructionSet ctorSet;
+        std::string shaderPath;
+        int priority = 0;
+    };
+
+    struct GraphicsEntry
+    {
+        GraphicsEntry(const GraphicsPipelineConstructionSet& aCtorSet, int aPriority = 0) : ctorSet(aCtorSet), priority(aPriority) {}
+
+        GraphicsPipelineConstructionSet ctorSet;
+        int priority = 0;
+    };
+
+    struct Manifest
+    {
+        std::vector<ShaderEntry> shaders;
+        std::vector<ComputeEntry> compute;
+        std::vector<GraphicsEntry> graphics;
+    };
+
+    /// Results in the same order as the manifest. Failed shaders are nullptr with a message in shaderErrors.
+    struct Results
+    {
+        std::vector<SharedShaderModule> shaders;
+        std::vector<std::string> shaderErrors;
+        std::vector<PipelineBuildResult<VulkanComputePipeline>> compute;
+        std::vector<PipelineBuildResult<VulkanRenderPipeline>> graphics;
+    };
+
+ protected:
+    struct _State
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        size_t completed = 0;
+        size_t total = 0;
+        Results results;
+
+        // Compute entries keep the modules they were built from alive
+        std::vector<SharedShaderModule> computeShaders;
+    };
+
+ public:
+    /// Handle to a started manifest
+    class Handle
+    {
+     public:
+        Handle(){}
+
+        bool isValid() const {return(_mState != nullptr);}
+
+        /// True once every entry has finished, successfully or not
+        bool poll() const;
+        void wait() const;
+
+        /// \returns true if every entry finished within aTimeout
+        bool waitFor(std::chrono::milliseconds aTimeout) const;
+
+        size_t getCompletedCount() const;
+        size_t getTotalCount() const;
+
+        /// Blocks until every entry has finished
+        const Results& getResults() const;
+
+     protected:
+        friend class PipelineWarmup;
+        Handle(const std::shared_ptr<_State>& aState) : _mState(aState) {}
+
+     private:
+        std::shared_ptr<_State> _mState;
+    };
+
+    /// \param aShaderCache Cache used for shader entries and compute shader paths. Its device is used for compute pipelines.
+    /// \param aSharedCache Pipeline cache used by entries without their own, e.g. PipelineCache::handle()
+    /// \param aWorkerCount Number of background threads. Zero uses std::thread::hardware_concurrency().
+    PipelineWarmup(ShaderModuleCache& aShaderCache, VkPipelineCache aSharedCache = VK_NULL_HANDLE, size_t aWorkerCount = 1);
+
+    /// Entries which have not started are completed with an error so no handle waits forever
+    ~PipelineWarmup() = default;
+
+    PipelineWarmup(const PipelineWarmup&) = delete;
+    PipelineWarmup& operator=(const PipelineWarmup&) = delete;
+
+    Handle start(const Manifest& aManifest);
+
+ protected:
+    static void _markComplete(_State& aState);
+
+    /// Load the entry's shader, if it names one, into aModuleOut and set it as the module of its stage
+    /// \returns false with a message in aErrorOut if the shader could not be loaded
+    bool _bindCachedShader(ComputeEntry& aEntry, SharedShaderModule& aModuleOut, std::string& aErrorOut);
+
+    ShaderModuleCache& mShaderCache;
+
+    // Destroyed first, cancelling the entries which have not started
+    PipelineCompiler mCompiler;
+};
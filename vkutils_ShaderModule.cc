@@ -0,0 +1,183 @@
+#include "vkutils.h"
+#include <cstring>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vkutils{
+
+MappedSpirvFile::MappedSpirvFile(const std::string& aFilePath){
+#ifdef _WIN32
+    HANDLE file = CreateFileA(aFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open shader file " + aFilePath + "!");
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(file, &fileSize);
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+
+    HANDLE mapping = (mSize == 0) ? nullptr : CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if(mapping != nullptr){
+        mData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        // The view keeps the mapping object alive
+        CloseHandle(mapping);
+    }
+#else
+    int fd = open(aFilePath.c_str(), O_RDONLY);
+    if(fd < 0){
+        perror(aFilePath.c_str());
+        throw std::runtime_error("Failed to open shader file " + aFilePath + "!");
+    }
+    struct stat fileStat = {};
+    if(fstat(fd, &fileStat) == 0) mSize = static_cast<size_t>(fileStat.st_size);
+
+    if(mSize > 0){
+        void* mapped = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        mData = (mapped == MAP_FAILED) ? nullptr : mapped;
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+#endif
+
+    if(mSize == 0) throw std::runtime_error("Shader file " + aFilePath + " is empty!");
+    if(mData == nullptr){
+        mSize = 0;
+        throw std::runtime_error("Failed to map shader file " + aFilePath + "!");
+    }
+
+    // Mappings are page aligned, so only the length can break word alignment
+    std::string problem;
+    if(mSize % sizeof(uint32_t) != 0){
+        problem = "size is not a multiple of 4 bytes";
+    }else if(words()[0] != sSpirvMagic){
+        problem = (words()[0] == 0x03022307) ? "byte order does not match the host" : "missing SPIR-V magic number";
+    }
+    if(!problem.empty()){
+        unmap();
+        throw std::runtime_error("Shader file " + aFilePath + " is not valid SPIR-V (" + problem + ")!");
+    }
+}
+
+MappedSpirvFile& MappedSpirvFile::operator=(MappedSpirvFile&& aOther) noexcept{
+    if(this != &aOther){
+        unmap();
+        mData = aOther.mData;
+        mSize = aOther.mSize;
+        aOther.mData = nullptr;
+        aOther.mSize = 0;
+    }
+    return(*this);
+}
+
+void MappedSpirvFile::unmap(){
+    if(mData == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mData);
+#else
+    munmap(const_cast<void*>(mData), mSize);
+#endif
+    mData = nullptr;
+    mSize = 0;
+}
+
+SharedShaderModule ShaderModuleCache::_findLocked(const _Key& aKey, const uint32_t* aCode) const{
+    auto range = _mModules.equal_range(aKey);
+    for(auto iter = range.first; iter != range.second; ++iter){
+        if(std::memcmp(iter->second.code.data(), aCode, aKey.codeSize) == 0) return(iter->second.module);
+    }
+    return(nullptr);
+}
+
+SharedShaderModule ShaderModuleCache::getOrCreate(const uint32_t* aCode, size_t aCodeSize){
+    const _Key key = {hashSpirv(aCode, aCodeSize / sizeof(uint32_t)), aCodeSize};
+    {
+        std::lock_guard<std::mutex> lock(_mMutex);
+        SharedShaderModule found = _findLocked(key, aCode);
+        if(found != nullptr){
+            _mHits.fetch_add(1, std::memory_order_relaxed);
+            return(found);
+        }
+    }
+    _mMisses.fetch_add(1, std::memory_order_relaxed);
+
+    VkShaderModule module = create_shader_module(mDevice, aCode, aCodeSize);
+    if(module == VK_NULL_HANDLE) return(nullptr);
+
+    CachedShaderModule* cached = new CachedShaderModule{module, key.hash, aCodeSize};
+    VkDevice device = mDevice;
+    SharedShaderModule shared(cached, [device](const CachedShaderModule* aCached){
+        vkDestroyShaderModule(device, aCached->module, nullptr);
+        delete aCached;
+    });
+
+    // Another thread may have created the same module meanwhile, in which case ours is dropped
+    std::lock_guard<std::mutex> lock(_mMutex);
+    SharedShaderModule found = _findLocked(key, aCode);
+    if(found != nullptr) return(found);
+
+    const uint8_t* codeBytes = reinterpret_cast<const uint8_t*>(aCode);
+    _mModules.emplace(key, _Entry{std::vector<uint8_t>(codeBytes, codeBytes + aCodeSize), shared});
+    return(shared);
+}
+
+SharedShaderModule ShaderModuleCache::getOrCreate(const std::vector<uint8_t>& aByteCode){
+    return(getOrCreate(reinterpret_cast<const uint32_t*>(aByteCode.data()), aByteCode.size()));
+}
+
+SharedShaderModule ShaderModuleCache::load(const std::string& aFilePath){
+    MappedSpirvFile spirvFile(aFilePath);
+    SharedShaderModule module = getOrCreate(spirvFile.words(), spirvFile.size());
+    if(module == nullptr){
+        std::cerr << "Failed to create shader module from '" << aFilePath << "'!" << std::endl;
+    }
+    return(module);
+}
+
+size_t ShaderModuleCache::trim(){
+    std::lock_guard<std::mutex> lock(_mMutex);
+    size_t released = 0;
+    auto iter = _mModules.begin();
+    while(iter != _mModules.end()){
+        if(iter->second.module.use_count() == 1){
+            iter = _mModules.erase(iter);
+            ++released;
+        }else{
+            ++iter;
+        }
+    }
+    return(released);
+}
+
+void ShaderModuleCache::clear(){
+    std::lock_guard<std::mutex> lock(_mMutex);
+    _mModules.clear();
+}
+
+size_t ShaderModuleCache::size() const{
+    std::lock_guard<std::mutex> lock(_mMutex);
+    return(_mModules.size());
+}
+
+uint64_t ShaderModuleCache::hashSpirv(const uint32_t* aWords, size_t aWordCount){
+    // FNV-1a over whole words followed by a 64-bit finalizer to spread the low bits
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for(size_t i = 0; i < aWordCount; ++i){
+        hash ^= aWords[i];
+        hash *= 0x100000001B3ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return(hash);
+}
+
+} // end namespace vkutils
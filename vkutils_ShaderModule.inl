@@ -0,0 +1,115 @@
+/// Read-only memory mapping of a SPIR-V binary.
+///
+/// The mapped pages are handed to vkCreateShaderModule() directly, so loading a module costs no heap 
+/// allocation or copy of the bytecode. The file is checked on open: it must be non-empty, a multiple of
+/// four bytes long, and start with the SPIR-V magic number in host byte order. Failures throw.
+class MappedSpirvFile
+{
+ public:
+    static constexpr uint32_t sSpirvMagic = 0x07230203;
+
+    MappedSpirvFile(){}
+    MappedSpirvFile(const std::string& aFilePath);
+    ~MappedSpirvFile(){unmap();}
+
+    MappedSpirvFile(const MappedSpirvFile&) = delete;
+    MappedSpirvFile& operator=(const MappedSpirvFile&) = delete;
+    MappedSpirvFile(MappedSpirvFile&& aOther) noexcept {*this = std::move(aOther);}
+    MappedSpirvFile& operator=(MappedSpirvFile&& aOther) noexcept;
+
+    bool isValid() const {return(mData != nullptr);}
+
+    const uint32_t* words() const {return(static_cast<const uint32_t*>(mData));}
+    size_t wordCount() const {return(mSize / sizeof(uint32_t));}
+
+    /// Size of the mapping in bytes
+    size_t size() const {return(mSize);}
+
+    void unmap();
+
+ protected:
+    const void* mData = nullptr;
+    size_t mSize = 0;
+};
+
+/// Shader module owned by a ShaderModuleCache. The module is destroyed once the cache and every holder
+/// of the shared pointer have released it.
+struct CachedShaderModule
+{
+    VkShaderModule module = VK_NULL_HANDLE;
+    uint64_t hash = 0;
+    size_t codeSize = 0;
+
+    operator VkShaderModule() const {return(module);}
+};
+
+using SharedShaderModule = std::shared_ptr<const CachedShaderModule>;
+
+/// Device scoped cache which hands out one shared VkShaderModule per distinct SPIR-V binary.
+///
+/// Bytecode is looked up by a 64-bit hash of its word stream together with its size, and a hit is confirmed
+/// against a copy of the bytecode kept with the module, so a hash collision never returns the wrong shader.
+/// The cache keeps a reference to every module it creates until trim() or clear() is called, so reloading
+/// the same shader later still hits. Safe to use from multiple threads; modules are created outside the lock,
+/// so misses on different threads proceed in parallel.
+class ShaderModuleCache
+{
+ public:
+    ShaderModuleCache(VkDevice aDevice) : mDevice(aDevice) {}
+    ~ShaderModuleCache(){clear();}
+
+    ShaderModuleCache(const ShaderModuleCache&) = delete;
+    ShaderModuleCache& operator=(const ShaderModuleCache&) = delete;
+
+    /// \returns The module for `aCode`, creating it on a miss, or nullptr if creation failed
+    SharedShaderModule getOrCreate(const uint32_t* aCode, size_t aCodeSize);
+    SharedShaderModule getOrCreate(const std::vector<uint8_t>& aByteCode);
+
+    /// Memory map the SPIR-V file at aFilePath and look it up. Throws like MappedSpirvFile.
+    SharedShaderModule load(const std::string& aFilePath);
+
+    /// Release cached modules which nobody else holds. \returns The number of modules released.
+    size_t trim();
+
+    /// Release every cached reference. Modules still held elsewhere stay alive until their last holder drops them.
+    void clear();
+
+    VkDevice getDevice() const {return(mDevice);}
+    size_t size() const;
+    uint64_t getHitCount() const {return(_mHits.load(std::memory_order_relaxed));}
+    uint64_t getMissCount() const {return(_mMisses.load(std::memory_order_relaxed));}
+
+    /// 64-bit hash of a SPIR-V word stream
+    static uint64_t hashSpirv(const uint32_t* aWords, size_t aWordCount);
+
+ protected:
+    struct _Key
+    {
+        uint64_t hash;
+        size_t codeSize;
+
+        bool operator==(const _Key& aOther) const {return(hash == aOther.hash && codeSize == aOther.codeSize);}
+    };
+
+    struct _KeyHash
+    {
+        size_t operator()(const _Key& aKey) const noexcept {return(static_cast<size_t>(aKey.hash ^ (aKey.codeSize * 0x9E3779B97F4A7C15ull)));}
+    };
+
+    struct _Entry
+    {
+        std::vector<uint8_t> code;
+        SharedShaderModule module;
+    };
+
+    /// Module created from exactly aCode, or nullptr. Call with _mMutex held.
+    SharedShaderModule _findLocked(const _Key& aKey, const uint32_t* aCode) const;
+
+    VkDevice mDevice = VK_NULL_HANDLE;
+
+ private:
+    mutable std::mutex _mMutex;
+    std::unordered_multimap<_Key, _Entry, _KeyHash> _mModules;
+    std::atomic<uint64_t> _mHits{0};
+    std::atomic<uint64_t> _mMisses{0};
+};
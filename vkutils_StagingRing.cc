@@ -0,0 +1,155 @@
+#include "vkutils.h"
+#include "VmaHost.h"
+#include <cstring>
+#include <iostream>
+
+namespace vkutils{
+
+StagingRing::StagingRing(QueueClosure& aQueue, VkDeviceSize aCapacity)
+: mQueue(aQueue), mCapacity(aCapacity)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    {
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = mCapacity;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    VmaAllocationCreateInfo allocInfo = {};
+    {
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    }
+
+    mAllocator = VmaHost::getAllocator(mQueue.getDevicePair());
+    VmaAllocationInfo allocResult = {};
+    VkResult createResult = vmaCreateBuffer(mAllocator, &bufferInfo, &allocInfo, &mBuffer, &mAllocation, &allocResult);
+    if(createResult != VK_SUCCESS){
+        throw std::runtime_error("Failed to create staging ring buffer! (" + std::string(vk_result_str(createResult)) + ")");
+    }
+    mMapped = static_cast<uint8_t*>(allocResult.pMappedData);
+}
+
+StagingRing::~StagingRing(){
+    // A destructor must not throw: report a failed submit or wait and still release the buffer.
+    try{
+        if(hasPendingUploads()) flush();
+        while(!_mRegions.empty()){
+            _mRegions.front().handle.wait();
+            _mRegions.pop_front();
+        }
+    }catch(const std::exception& e){
+        std::cerr << "Warning: StagingRing failed to retire pending uploads on destruction: " << e.what() << std::endl;
+    }
+    vmaDestroyBuffer(mAllocator, mBuffer, mAllocation);
+}
+
+void StagingRing::uploadToBuffer(VkBuffer aDstBuffer, VkDeviceSize aDstOffset, const void* aData, VkDeviceSize aSize){
+    VkBufferCopy region = {};
+    region.srcOffset = _stage(aData, aSize, 4);
+    region.dstOffset = aDstOffset;
+    region.size = aSize;
+    vkCmdCopyBuffer(_getPendingCommands(), mBuffer, aDstBuffer, 1, &region);
+}
+
+void StagingRing::uploadToImage(
+    VkImage aDstImage,
+    VkImageLayout aDstLayout,
+    const VkBufferImageCopy& aRegion,
+    const void* aData,
+    VkDeviceSize aSize,
+    VkDeviceSize aAlignment
+){
+    VkBufferImageCopy region = aRegion;
+    region.bufferOffset = _stage(aData, aSize, aAlignment);
+    vkCmdCopyBufferToImage(_getPendingCommands(), mBuffer, aDstImage, aDstLayout, 1, &region);
+}
+
+SubmitHandle StagingRing::flush(const std::vector<VkSemaphore>& aWaitSemaphores, const std::vector<VkSemaphore>& aSignalSemaphores){
+    if(!hasPendingUploads()) return(SubmitHandle());
+
+    VkCommandBuffer cmdBuffer = _mPendingCmdBuffer;
+    _mPendingCmdBuffer = VK_NULL_HANDLE;
+    SubmitHandle handle = mQueue.finishOneSubmitCommandsAsync(cmdBuffer, aWaitSemaphores, aSignalSemaphores);
+
+    _mRegions.push_back(_Region{_mHead, _mPendingBytes, handle});
+    _mPendingBytes = 0;
+    return(handle);
+}
+
+void StagingRing::reclaim(){
+    while(!_mRegions.empty() && _mRegions.front().handle.poll()){
+        _retireFront();
+    }
+}
+
+VkDeviceSize StagingRing::_stage(const void* aData, VkDeviceSize aSize, VkDeviceSize aAlignment){
+    if(aSize > mCapacity){
+        throw std::runtime_error("Upload of " + std::to_string(aSize) + " bytes does not fit in the staging ring!");
+    }
+
+    VkDeviceSize offset = 0;
+    reclaim();
+    while(!_tryAllocate(aSize, aAlignment, offset)){
+        // Copies recorded so far may be what holds the space, so submit them before waiting
+        if(hasPendingUploads()) flush();
+        if(_mRegions.empty()){
+            throw std::runtime_error("Staging ring cannot satisfy an upload of " + std::to_string(aSize) + " bytes!");
+        }
+        _mRegions.front().handle.wait();
+        _retireFront();
+    }
+
+    std::memcpy(mMapped + offset, aData, static_cast<size_t>(aSize));
+    // No-op on host coherent memory
+    vmaFlushAllocation(mAllocator, mAllocation, offset, aSize);
+    return(offset);
+}
+
+bool StagingRing::_tryAllocate(VkDeviceSize aSize, VkDeviceSize aAlignment, VkDeviceSize& aOffsetOut){
+    if(_mUsed == 0){
+        // Nothing is live, so start over at the front to keep the free span contiguous
+        _mHead = 0;
+        _mTail = 0;
+    }else if(_mHead == _mTail){
+        return(false);
+    }
+
+    VkDeviceSize offset = ((_mHead + aAlignment - 1) / aAlignment) * aAlignment;
+    VkDeviceSize consumed = 0;
+    if(_mHead >= _mTail){
+        if(offset + aSize <= mCapacity){
+            consumed = offset + aSize - _mHead;
+        }else if(aSize <= _mTail){
+            // Skip the end of the ring and wrap around to the front
+            consumed = (mCapacity - _mHead) + aSize;
+            offset = 0;
+        }else{
+            return(false);
+        }
+    }else{
+        if(offset + aSize > _mTail) return(false);
+        consumed = offset + aSize - _mHead;
+    }
+
+    _mHead = (offset + aSize == mCapacity) ? 0 : offset + aSize;
+    _mUsed += consumed;
+    _mPendingBytes += consumed;
+    aOffsetOut = offset;
+    return(true);
+}
+
+VkCommandBuffer StagingRing::_getPendingCommands(){
+    if(_mPendingCmdBuffer == VK_NULL_HANDLE) _mPendingCmdBuffer = mQueue.beginOneSubmitCommands();
+    return(_mPendingCmdBuffer);
+}
+
+void StagingRing::_retireFront(){
+    const _Region& region = _mRegions.front();
+    _mTail = region.end;
+    _mUsed -= region.bytes;
+    _mRegions.pop_front();
+}
+
+} // end namespace vkutils
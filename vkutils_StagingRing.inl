@@ -0,0 +1,80 @@
+/// Persistently mapped staging buffer used as a ring for host to device uploads through a QueueClosure.
+///
+/// Each upload copies its data into the next free span of the ring and records a vkCmdCopyBuffer or 
+/// vkCmdCopyBufferToImage into a pending transfer command buffer. flush() submits every pending copy in 
+/// one submit. A span is reused once the submit that read it has completed, which is tracked through the
+/// submit's SubmitHandle (a pooled fence, or the closure's timeline when one is attached). When the ring is
+/// full, uploads flush and then wait on the oldest submit until enough space has been retired.
+///
+/// The buffer is allocated through VmaHost. A ring is not thread-safe and must be used on the thread that
+/// records its uploads, like SubmitBatcher.
+class StagingRing
+{
+ public:
+    StagingRing(QueueClosure& aQueue, VkDeviceSize aCapacity = 64ull * 1024 * 1024);
+
+    /// Flushes pending uploads and waits for every submit which reads from the ring
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    /// Copy aSize bytes of aData into the ring and record a copy into aDstBuffer at aDstOffset
+    void uploadToBuffer(VkBuffer aDstBuffer, VkDeviceSize aDstOffset, const void* aData, VkDeviceSize aSize);
+
+    /// Copy aSize bytes of aData into the ring and record a copy into aDstImage. The bufferOffset of aRegion
+    /// is filled in by the ring. aDstImage must already be in aDstLayout (TRANSFER_DST_OPTIMAL or GENERAL).
+    /// \param aAlignment Offset alignment for the staged data, which must be a multiple of the format's texel block size
+    void uploadToImage(
+        VkImage aDstImage,
+        VkImageLayout aDstLayout,
+        const VkBufferImageCopy& aRegion,
+        const void* aData,
+        VkDeviceSize aSize,
+        VkDeviceSize aAlignment = 16
+    );
+
+    /// Submit every pending copy in one batch.
+    /// \returns Handle for the submit, or an already complete handle when nothing was pending
+    SubmitHandle flush(const std::vector<VkSemaphore>& aWaitSemaphores = {}, const std::vector<VkSemaphore>& aSignalSemaphores = {});
+
+    /// Return the space of every completed submit to the ring without blocking
+    void reclaim();
+
+    VkBuffer getBuffer() const {return(mBuffer);}
+    VkDeviceSize getCapacity() const {return(mCapacity);}
+
+    /// Bytes which are pending or in flight, including space skipped when wrapping
+    VkDeviceSize getUsedBytes() const {return(_mUsed);}
+    bool hasPendingUploads() const {return(_mPendingCmdBuffer != VK_NULL_HANDLE);}
+
+ protected:
+    /// Span of the ring read by one submit
+    struct _Region
+    {
+        VkDeviceSize end;
+        VkDeviceSize bytes;
+        SubmitHandle handle;
+    };
+
+    /// Copy aData into the ring and return its offset, flushing and waiting when the ring is full
+    VkDeviceSize _stage(const void* aData, VkDeviceSize aSize, VkDeviceSize aAlignment);
+    bool _tryAllocate(VkDeviceSize aSize, VkDeviceSize aAlignment, VkDeviceSize& aOffsetOut);
+    VkCommandBuffer _getPendingCommands();
+    void _retireFront();
+
+    QueueClosure& mQueue;
+    VkDeviceSize mCapacity = 0;
+    VkBuffer mBuffer = VK_NULL_HANDLE;
+    VmaAllocator mAllocator = nullptr;
+    VmaAllocation mAllocation = VK_NULL_HANDLE;
+    uint8_t* mMapped = nullptr;
+
+ private:
+    VkDeviceSize _mHead = 0;
+    VkDeviceSize _mTail = 0;
+    VkDeviceSize _mUsed = 0;
+    VkDeviceSize _mPendingBytes = 0;
+    VkCommandBuffer _mPendingCmdBuffer = VK_NULL_HANDLE;
+    std::deque<_Region> _mRegions;
+};
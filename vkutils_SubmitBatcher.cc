@@ -0,0 +1,99 @@
+#include "vkutils.h"
+
+namespace vkutils{
+
+SubmitHandle SubmitBatcher::enqueue(
+    const VkCommandBuffer& aCmdBuffer,
+    const std::vector<VkSemaphore>& aWaitSemaphores,
+    const std::vector<VkPipelineStageFlags>& aWaitStages,
+    const std::vector<VkSemaphore>& aSignalSemaphores,
+    const std::vector<uint64_t>& aWaitValues
+){
+    ASSERT_VK_SUCCESS(vkEndCommandBuffer(aCmdBuffer));
+
+    if(_mPending.empty()){
+        _mBatchState = mQueue._createSubmitState();
+        _mOldestPending = std::chrono::steady_clock::now();
+    }
+
+    _PendingSubmit pending;
+    pending.cmdBuffer = aCmdBuffer;
+    pending.waitSemaphores = aWaitSemaphores;
+    pending.waitStages = aWaitStages;
+    pending.waitStages.resize(aWaitSemaphores.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    if(!aWaitValues.empty()){
+        pending.waitValues = aWaitValues;
+        pending.waitValues.resize(aWaitSemaphores.size(), 0);
+    }
+    pending.signalSemaphores = aSignalSemaphores;
+    _mPending.push_back(std::move(pending));
+
+    SubmitHandle handle(_mBatchState);
+    if(mMaxBatchSize != 0 && _mPending.size() >= mMaxBatchSize){
+        flush();
+    }else{
+        flushIfDue();
+    }
+    return(handle);
+}
+
+VkResult SubmitBatcher::flushIfDue(){
+    if(_mPending.empty() || mMaxLatency.count() == 0) return(VK_SUCCESS);
+    if(std::chrono::steady_clock::now() - _mOldestPending < mMaxLatency) return(VK_SUCCESS);
+    return(flush());
+}
+
+VkResult SubmitBatcher::flush(){
+    if(_mPending.empty()) return(VK_SUCCESS);
+
+    // Gather command buffers and semaphores into flat arrays first so the submit infos can point into them
+    std::vector<VkCommandBuffer> cmdBuffers;
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkSemaphore> signalSemaphores;
+    cmdBuffers.reserve(_mPending.size());
+    for(const _PendingSubmit& pending : _mPending){
+        cmdBuffers.push_back(pending.cmdBuffer);
+        waitSemaphores.insert(waitSemaphores.end(), pending.waitSemaphores.begin(), pending.waitSemaphores.end());
+        waitStages.insert(waitStages.end(), pending.waitStages.begin(), pending.waitStages.end());
+        waitValues.resize(waitSemaphores.size(), 0);
+        if(!pending.waitValues.empty()){
+            std::copy(pending.waitValues.begin(), pending.waitValues.end(), waitValues.end() - pending.waitValues.size());
+        }
+        signalSemaphores.insert(signalSemaphores.end(), pending.signalSemaphores.begin(), pending.signalSemaphores.end());
+    }
+
+    // Consecutive command buffers share a submit info unless a wait would hoist above earlier
+    // buffers or a signal would be delayed past later ones
+    std::vector<VkSubmitInfo> submissions;
+    std::vector<const uint64_t*> submissionWaitValues;
+    size_t waitOffset = 0;
+    size_t signalOffset = 0;
+    for(size_t i = 0; i < _mPending.size(); ++i){
+        const _PendingSubmit& pending = _mPending[i];
+        bool startNew = submissions.empty() || !pending.waitSemaphores.empty() || submissions.back().signalSemaphoreCount != 0;
+        if(startNew){
+            VkSubmitInfo submission = sSingleSubmitTemplate;
+            submission.commandBufferCount = 0;
+            submission.pCommandBuffers = cmdBuffers.data() + i;
+            submission.waitSemaphoreCount = static_cast<uint32_t>(pending.waitSemaphores.size());
+            submission.pWaitSemaphores = waitSemaphores.data() + waitOffset;
+            submission.pWaitDstStageMask = waitStages.data() + waitOffset;
+            submission.pSignalSemaphores = signalSemaphores.data() + signalOffset;
+            submissions.push_back(submission);
+            submissionWaitValues.push_back(pending.waitValues.empty() ? nullptr : waitValues.data() + waitOffset);
+        }
+        submissions.back().commandBufferCount += 1;
+        submissions.back().signalSemaphoreCount += static_cast<uint32_t>(pending.signalSemaphores.size());
+        waitOffset += pending.waitSemaphores.size();
+        signalOffset += pending.signalSemaphores.size();
+    }
+
+    VkResult submitResult = mQueue._submitBatch(submissions, submissionWaitValues, cmdBuffers, _mBatchState);
+    _mPending.clear();
+    _mBatchState.reset();
+    return(submitResult);
+}
+
+} // end namespace vkutils
@@ -0,0 +1,66 @@
+/// Coalesces one-shot command buffers from a QueueClosure into a single vkQueueSubmit.
+///
+/// Command buffers are begun through the batcher (or the closure's internal pool directly) and handed back
+/// with enqueue() in place of QueueClosure::finishOneSubmitCommands(). Pending buffers are submitted 
+/// together, one VkSubmitInfo per run of buffers that can share semaphores, when flush() is called or when 
+/// the size or latency threshold is reached. A batcher is not thread-safe and must be used on the thread 
+/// that begins its command buffers.
+class SubmitBatcher
+{
+ public:
+    /// \param aMaxBatchSize Number of pending command buffers which triggers a flush. Zero disables the threshold.
+    /// \param aMaxLatency Age of the oldest pending command buffer which triggers a flush on the next enqueue()
+    ///                    or flushIfDue(). Zero disables the threshold. 
+    SubmitBatcher(QueueClosure& aQueue, size_t aMaxBatchSize = 64, std::chrono::microseconds aMaxLatency = std::chrono::microseconds(0))
+    : mQueue(aQueue), mMaxBatchSize(aMaxBatchSize), mMaxLatency(aMaxLatency) {}
+
+    ~SubmitBatcher(){flush();}
+
+    SubmitBatcher(const SubmitBatcher&) = delete;
+    SubmitBatcher& operator=(const SubmitBatcher&) = delete;
+
+    VkCommandBuffer beginCommands() {return(mQueue.beginOneSubmitCommands());}
+
+    /// End `aCmdBuffer` and add it to the pending batch. 
+    /// 
+    /// \param aWaitStages Stage masks for `aWaitSemaphores`. Missing entries default to VK_PIPELINE_STAGE_ALL_COMMANDS_BIT.
+    /// \param aWaitValues Values to wait for on timeline semaphores in `aWaitSemaphores`. Entries of binary 
+    ///                    semaphores are ignored, and missing entries are 0.
+    /// \returns Handle which completes with the batch the command buffer is submitted in. It does not complete
+    ///          before that batch has been flushed.
+    SubmitHandle enqueue(
+        const VkCommandBuffer& aCmdBuffer,
+        const std::vector<VkSemaphore>& aWaitSemaphores = {},
+        const std::vector<VkPipelineStageFlags>& aWaitStages = {},
+        const std::vector<VkSemaphore>& aSignalSemaphores = {},
+        const std::vector<uint64_t>& aWaitValues = {}
+    );
+
+    /// Submit every pending command buffer in a single vkQueueSubmit. Does nothing if no buffers are pending.
+    VkResult flush();
+
+    /// Flush if the oldest pending command buffer is older than the latency threshold.
+    VkResult flushIfDue();
+
+    size_t pendingCount() const {return(_mPending.size());}
+    QueueClosure& getQueueClosure() const {return(mQueue);}
+
+ protected:
+    struct _PendingSubmit
+    {
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<uint64_t> waitValues;
+        std::vector<VkSemaphore> signalSemaphores;
+    };
+
+    QueueClosure& mQueue;
+    size_t mMaxBatchSize;
+    std::chrono::microseconds mMaxLatency;
+
+ private:
+    std::vector<_PendingSubmit> _mPending;
+    std::shared_ptr<SubmitHandle::_State> _mBatchState;
+    std::chrono::steady_clock::time_point _mOldestPending;
+};
@@ -0,0 +1,86 @@
+#include "vkutils.h"
+
+namespace vkutils{
+
+template<typename T>
+static void atomic_store_max(std::atomic<T>& aTarget, T aValue){
+    T current = aTarget.load(std::memory_order_relaxed);
+    while(current < aValue && !aTarget.compare_exchange_weak(current, aValue, std::memory_order_relaxed));
+}
+
+std::shared_ptr<SynchronizedQueue> SynchronizedQueue::get(VkQueue aQueue){
+    static std::mutex sRegistryMutex;
+    static std::unordered_map<VkQueue, std::weak_ptr<SynchronizedQueue>> sRegistry;
+
+    std::lock_guard<std::mutex> lock(sRegistryMutex);
+    std::weak_ptr<SynchronizedQueue>& entry = sRegistry[aQueue];
+    std::shared_ptr<SynchronizedQueue> queue = entry.lock();
+    if(queue == nullptr){
+        queue = std::shared_ptr<SynchronizedQueue>(new SynchronizedQueue(aQueue));
+        entry = queue;
+    }
+    return(queue);
+}
+
+VkResult SynchronizedQueue::submit(uint32_t aSubmitCount, const VkSubmitInfo* aSubmits, VkFence aFence){
+    VkResult submitResult = VK_SUCCESS;
+    {
+        std::unique_lock<std::mutex> lock = _lockQueue();
+        submitResult = vkQueueSubmit(mQueue, aSubmitCount, aSubmits, aFence);
+    }
+
+    _mSubmitCalls.fetch_add(1, std::memory_order_relaxed);
+    _mSubmitInfos.fetch_add(aSubmitCount, std::memory_order_relaxed);
+    atomic_store_max(_mMaxBatchSize, static_cast<uint64_t>(aSubmitCount));
+    if(submitResult != VK_SUCCESS) _mFailedSubmits.fetch_add(1, std::memory_order_relaxed);
+    return(submitResult);
+}
+
+VkResult SynchronizedQueue::present(const VkPresentInfoKHR& aPresentInfo){
+    std::unique_lock<std::mutex> lock = _lockQueue();
+    return(vkQueuePresentKHR(mQueue, &aPresentInfo));
+}
+
+VkResult SynchronizedQueue::waitIdle(){
+    std::unique_lock<std::mutex> lock = _lockQueue();
+    return(vkQueueWaitIdle(mQueue));
+}
+
+QueueSubmitStats SynchronizedQueue::getStats() const{
+    QueueSubmitStats stats;
+    stats.submitCalls = _mSubmitCalls.load(std::memory_order_relaxed);
+    stats.submitInfos = _mSubmitInfos.load(std::memory_order_relaxed);
+    stats.maxBatchSize = _mMaxBatchSize.load(std::memory_order_relaxed);
+    stats.failedSubmits = _mFailedSubmits.load(std::memory_order_relaxed);
+    stats.contendedLocks = _mContendedLocks.load(std::memory_order_relaxed);
+    stats.totalLockWait = std::chrono::nanoseconds(_mTotalLockWaitNs.load(std::memory_order_relaxed));
+    stats.maxLockWait = std::chrono::nanoseconds(_mMaxLockWaitNs.load(std::memory_order_relaxed));
+    return(stats);
+}
+
+void SynchronizedQueue::resetStats(){
+    _mSubmitCalls.store(0, std::memory_order_relaxed);
+    _mSubmitInfos.store(0, std::memory_order_relaxed);
+    _mMaxBatchSize.store(0, std::memory_order_relaxed);
+    _mFailedSubmits.store(0, std::memory_order_relaxed);
+    _mContendedLocks.store(0, std::memory_order_relaxed);
+    _mTotalLockWaitNs.store(0, std::memory_order_relaxed);
+    _mMaxLockWaitNs.store(0, std::memory_order_relaxed);
+}
+
+std::unique_lock<std::mutex> SynchronizedQueue::_lockQueue(){
+    // The uncontended path costs no clock reads
+    std::unique_lock<std::mutex> lock(_mQueueMutex, std::try_to_lock);
+    if(lock.owns_lock()) return(lock);
+
+    std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    lock.lock();
+    int64_t waitedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count();
+
+    _mContendedLocks.fetch_add(1, std::memory_order_relaxed);
+    _mTotalLockWaitNs.fetch_add(waitedNs, std::memory_order_relaxed);
+    atomic_store_max(_mMaxLockWaitNs, waitedNs);
+    return(lock);
+}
+
+} // end namespace vkutils
@@ -0,0 +1,56 @@
+/// Counters kept by a SynchronizedQueue. Lock wait time is only measured when the lock was contended.
+struct QueueSubmitStats
+{
+    uint64_t submitCalls = 0;
+    uint64_t submitInfos = 0;
+    uint64_t maxBatchSize = 0;
+    uint64_t failedSubmits = 0;
+    uint64_t contendedLocks = 0;
+    std::chrono::nanoseconds totalLockWait{0};
+    std::chrono::nanoseconds maxLockWait{0};
+
+    double averageBatchSize() const {return(submitCalls == 0 ? 0.0 : static_cast<double>(submitInfos) / submitCalls);}
+};
+
+/// VkQueue guarded by a lock, satisfying Vulkan's external synchronization rule for queue operations.
+///
+/// There is one instance per VkQueue, shared through get(), so every QueueClosure and other user of the
+/// same queue serializes on the same lock. Only the queue call itself runs under the lock.
+class SynchronizedQueue
+{
+ public:
+    /// \returns The shared wrapper for aQueue, creating it on first use
+    static std::shared_ptr<SynchronizedQueue> get(VkQueue aQueue);
+
+    SynchronizedQueue(const SynchronizedQueue&) = delete;
+    SynchronizedQueue& operator=(const SynchronizedQueue&) = delete;
+
+    VkQueue handle() const {return(mQueue);}
+
+    VkResult submit(uint32_t aSubmitCount, const VkSubmitInfo* aSubmits, VkFence aFence = VK_NULL_HANDLE);
+    VkResult submit(const VkSubmitInfo& aSubmit, VkFence aFence = VK_NULL_HANDLE) {return(submit(1, &aSubmit, aFence));}
+    VkResult present(const VkPresentInfoKHR& aPresentInfo);
+    VkResult waitIdle();
+
+    QueueSubmitStats getStats() const;
+    void resetStats();
+
+ protected:
+    SynchronizedQueue(VkQueue aQueue) : mQueue(aQueue) {}
+
+    /// Lock the queue, recording how long the lock took when another thread held it
+    std::unique_lock<std::mutex> _lockQueue();
+
+    VkQueue mQueue = VK_NULL_HANDLE;
+
+ private:
+    std::mutex _mQueueMutex;
+
+    std::atomic<uint64_t> _mSubmitCalls{0};
+    std::atomic<uint64_t> _mSubmitInfos{0};
+    std::atomic<uint64_t> _mMaxBatchSize{0};
+    std::atomic<uint64_t> _mFailedSubmits{0};
+    std::atomic<uint64_t> _mContendedLocks{0};
+    std::atomic<int64_t> _mTotalLockWaitNs{0};
+    std::atomic<int64_t> _mMaxLockWaitNs{0};
+};
@@ -0,0 +1,130 @@
+#include "vkutils.h"
+#include "VmaHost.h"
+
+namespace vkutils{
+
+TransientPool::TransientPool(
+    const VulkanDeviceHandlePair& aDevicePair,
+    const std::string& aName,
+    uint32_t aMemoryTypeIndex,
+    VkDeviceSize aBlockSize,
+    TransientPoolAlgorithm aAlgorithm,
+    size_t aBlockCount
+) : mDevicePair(aDevicePair), mName(aName), mAlgorithm(aAlgorithm)
+{
+    // Double stacks and ring buffers only exist within a single block
+    size_t blockCount = (aAlgorithm == TransientPoolAlgorithm::Linear) ? std::max<size_t>(aBlockCount, 1) : 1;
+
+    VmaPoolCreateInfo poolInfo = {};
+    {
+        poolInfo.memoryTypeIndex = aMemoryTypeIndex;
+        poolInfo.flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+        poolInfo.blockSize = aBlockSize;
+        poolInfo.minBlockCount = blockCount;
+        poolInfo.maxBlockCount = blockCount;
+    }
+
+    mAllocator = VmaHost::getAllocator(mDevicePair);
+    mPool = VmaHost::createPool(mDevicePair, mName, poolInfo);
+}
+
+TransientPool::~TransientPool(){
+    // VmaHost keeps the allocator while this pool holds allocations. Once they are released the pool is
+    // destroyed by handle, since its name may since have been taken by a new pool.
+    reset();
+    VmaHost::destroyPool(mDevicePair, mPool);
+}
+
+uint32_t TransientPool::findMemoryTypeIndex(const VulkanDeviceHandlePair& aDevicePair, const VkBufferCreateInfo& aBufferInfo, const VmaAllocationCreateInfo& aAllocInfo){
+    uint32_t memoryType = 0;
+    VkResult findResult = vmaFindMemoryTypeIndexForBufferInfo(VmaHost::getAllocator(aDevicePair), &aBufferInfo, &aAllocInfo, &memoryType);
+    if(findResult != VK_SUCCESS){
+        throw std::runtime_error("No memory type suits the transient pool's buffers! (" + std::string(vk_result_str(findResult)) + ")");
+    }
+    return(memoryType);
+}
+
+uint32_t TransientPool::findMemoryTypeIndex(const VulkanDeviceHandlePair& aDevicePair, const VkImageCreateInfo& aImageInfo, const VmaAllocationCreateInfo& aAllocInfo){
+    uint32_t memoryType = 0;
+    VkResult findResult = vmaFindMemoryTypeIndexForImageInfo(VmaHost::getAllocator(aDevicePair), &aImageInfo, &aAllocInfo, &memoryType);
+    if(findResult != VK_SUCCESS){
+        throw std::runtime_error("No memory type suits the transient pool's images! (" + std::string(vk_result_str(findResult)) + ")");
+    }
+    return(memoryType);
+}
+
+VmaAllocationCreateInfo TransientPool::_allocInfo(bool aUpper, VmaAllocationCreateFlags aFlags) const{
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.pool = mPool;
+    allocInfo.flags = aFlags;
+    if(aUpper){
+        assert(mAlgorithm == TransientPoolAlgorithm::DoubleStack);
+        allocInfo.flags |= VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT;
+    }
+    return(allocInfo);
+}
+
+VkResult TransientPool::createBuffer(
+    const VkBufferCreateInfo& aBufferInfo,
+    VkBuffer* aBufferOut,
+    VmaAllocationInfo* aAllocationInfoOut,
+    bool aUpper,
+    VmaAllocationCreateFlags aFlags
+){
+    VmaAllocationCreateInfo allocInfo = _allocInfo(aUpper, aFlags);
+    _Allocation entry = {VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+    VkResult createResult = vmaCreateBuffer(mAllocator, &aBufferInfo, &allocInfo, &entry.buffer, &entry.allocation, aAllocationInfoOut);
+    if(createResult != VK_SUCCESS) return(createResult);
+
+    _mAllocations.push_back(entry);
+    *aBufferOut = entry.buffer;
+    return(VK_SUCCESS);
+}
+
+VkResult TransientPool::createImage(
+    const VkImageCreateInfo& aImageInfo,
+    VkImage* aImageOut,
+    VmaAllocationInfo* aAllocationInfoOut,
+    bool aUpper,
+    VmaAllocationCreateFlags aFlags
+){
+    VmaAllocationCreateInfo allocInfo = _allocInfo(aUpper, aFlags);
+    _Allocation entry = {VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+    VkResult createResult = vmaCreateImage(mAllocator, &aImageInfo, &allocInfo, &entry.image, &entry.allocation, aAllocationInfoOut);
+    if(createResult != VK_SUCCESS) return(createResult);
+
+    _mAllocations.push_back(entry);
+    *aImageOut = entry.image;
+    return(VK_SUCCESS);
+}
+
+void TransientPool::_release(const _Allocation& aAllocation){
+    if(aAllocation.buffer != VK_NULL_HANDLE){
+        vmaDestroyBuffer(mAllocator, aAllocation.buffer, aAllocation.allocation);
+    }else{
+        vmaDestroyImage(mAllocator, aAllocation.image, aAllocation.allocation);
+    }
+}
+
+void TransientPool::popTo(Marker aMarker){
+    while(mark() > aMarker && !_mAllocations.empty()){
+        _release(_mAllocations.back());
+        _mAllocations.pop_back();
+    }
+}
+
+void TransientPool::releaseBefore(Marker aMarker){
+    while(_mFirstMarker < aMarker && !_mAllocations.empty()){
+        _release(_mAllocations.front());
+        _mAllocations.pop_front();
+        ++_mFirstMarker;
+    }
+}
+
+VmaStatistics TransientPool::getStatistics() const{
+    VmaStatistics stats = {};
+    vmaGetPoolStatistics(mAllocator, mPool, &stats);
+    return(stats);
+}
+
+} // end namespace vkutils
@@ -0,0 +1,105 @@
+
+/// Allocation strategy of a TransientPool. All three use VMA's linear algorithm, which places each allocation
+/// directly after the previous one.
+enum class TransientPoolAlgorithm
+{
+    Linear,      ///< Stack over one or more blocks. Free with popTo() or reset().
+    DoubleStack, ///< Two stacks growing toward each other from the ends of one block
+    RingBuffer   ///< One block, freed oldest first with releaseBefore()
+};
+
+/// Named custom VMA pool of fixed size blocks for short lived buffers and images, e.g. per frame data.
+///
+/// Allocation bumps a pointer in the current block. The pool owns every resource it creates and tracks
+/// them in allocation order, so a whole frame can be released at once with reset(), popTo() or
+/// releaseBefore() instead of one destroy call per resource. The VmaPool is registered in VmaHost under
+/// the pool's name, and is destroyed with the TransientPool. VmaHost::destroyAllocator() refuses while the
+/// pool holds allocations, so destroy or reset TransientPools before the allocator.
+///
+/// Not thread-safe. Resources must not be in use by the GPU when they are released.
+class TransientPool
+{
+ public:
+    /// Sequence number of an allocation, from mark()
+    using Marker = uint64_t;
+
+    /// \param aMemoryTypeIndex Memory type for every block, see findMemoryTypeIndex()
+    /// \param aBlockCount Number of blocks for Linear pools. DoubleStack and RingBuffer pools always use one.
+    TransientPool(
+        const VulkanDeviceHandlePair& aDevicePair,
+        const std::string& aName,
+        uint32_t aMemoryTypeIndex,
+        VkDeviceSize aBlockSize,
+        TransientPoolAlgorithm aAlgorithm = TransientPoolAlgorithm::Linear,
+        size_t aBlockCount = 1
+    );
+
+    /// Releases every resource still allocated and destroys the pool
+    ~TransientPool();
+
+    TransientPool(const TransientPool&) = delete;
+    TransientPool& operator=(const TransientPool&) = delete;
+
+    /// Memory type that VMA would choose for resources like aBufferInfo or aImageInfo with aAllocInfo
+    static uint32_t findMemoryTypeIndex(const VulkanDeviceHandlePair& aDevicePair, const VkBufferCreateInfo& aBufferInfo, const VmaAllocationCreateInfo& aAllocInfo);
+    static uint32_t findMemoryTypeIndex(const VulkanDeviceHandlePair& aDevicePair, const VkImageCreateInfo& aImageInfo, const VmaAllocationCreateInfo& aAllocInfo);
+
+    /// Allocate a buffer from the pool. The pool keeps ownership.
+    /// \param aUpper Allocate from the upper stack of a DoubleStack pool
+    /// \param aFlags Extra allocation flags, e.g. VMA_ALLOCATION_CREATE_MAPPED_BIT for host visible pools
+    VkResult createBuffer(
+        const VkBufferCreateInfo& aBufferInfo,
+        VkBuffer* aBufferOut,
+        VmaAllocationInfo* aAllocationInfoOut = nullptr,
+        bool aUpper = false,
+        VmaAllocationCreateFlags aFlags = 0
+    );
+
+    /// Image counterpart of createBuffer()
+    VkResult createImage(
+        const VkImageCreateInfo& aImageInfo,
+        VkImage* aImageOut,
+        VmaAllocationInfo* aAllocationInfoOut = nullptr,
+        bool aUpper = false,
+        VmaAllocationCreateFlags aFlags = 0
+    );
+
+    /// Marker of the next allocation
+    Marker mark() const {return(_mFirstMarker + _mAllocations.size());}
+
+    /// Release every resource allocated at or after aMarker, newest first
+    void popTo(Marker aMarker);
+
+    /// Release every resource allocated before aMarker, oldest first, as a ring buffer frees finished frames
+    void releaseBefore(Marker aMarker);
+
+    /// Release every resource in the pool
+    void reset() {popTo(_mFirstMarker);}
+
+    VmaPool getPool() const {return(mPool);}
+    const std::string& getName() const {return(mName);}
+    TransientPoolAlgorithm getAlgorithm() const {return(mAlgorithm);}
+    size_t getAllocationCount() const {return(_mAllocations.size());}
+    VmaStatistics getStatistics() const;
+
+ protected:
+    struct _Allocation
+    {
+        VmaAllocation allocation;
+        VkBuffer buffer;
+        VkImage image;
+    };
+
+    VmaAllocationCreateInfo _allocInfo(bool aUpper, VmaAllocationCreateFlags aFlags) const;
+    void _release(const _Allocation& aAllocation);
+
+    VulkanDeviceHandlePair mDevicePair;
+    std::string mName;
+    TransientPoolAlgorithm mAlgorithm;
+    VmaAllocator mAllocator = nullptr;
+    VmaPool mPool = VK_NULL_HANDLE;
+
+ private:
+    std::deque<_Allocation> _mAllocations;
+    Marker _mFirstMarker = 0;
+};
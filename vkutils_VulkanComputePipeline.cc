@@ -10,7 +10,7 @@ VulkanComputePipeline VulkanComputePipelineBuilder::build(VkDevice aLogicalDevic
 
     mCtorSet.mComputePipelineInfo.layout = mLayout;
 
-    if(vkCreateComputePipelines(aLogicalDevice, VK_NULL_HANDLE, 1, &mCtorSet.mComputePipelineInfo, nullptr, &mPipeline) != VK_SUCCESS){
+    if(vkCreateComputePipelines(aLogicalDevice, mCtorSet.mPipelineCache, 1, &mCtorSet.mComputePipelineInfo, nullptr, &mPipeline) != VK_SUCCESS){
         throw std::runtime_error("Failed when creating compute pipeline!");
     }
 
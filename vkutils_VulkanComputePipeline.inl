@@ -25,6 +25,9 @@ struct ComputePipelineConstructionSet
     VkPipelineShaderStageCreateInfo mShaderStage = {};
     VkPipelineLayoutCreateInfo mLayoutInfo = {};
     VkComputePipelineCreateInfo mComputePipelineInfo = {}; 
+
+    // Optional cache used when creating the pipeline, e.g. PipelineCache::handle()
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
 };
 
 class VulkanComputePipelineBuilder : public VulkanComputePipeline
@@ -97,7 +97,7 @@ void VulkanBasicRasterPipelineBuilder::build(const GraphicsPipelineConstructionS
         pipelineInfo.basePipelineIndex = -1;
     }
 
-    if(vkCreateGraphicsPipelines(aFinalCtorSet.mDevicePair.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mGraphicsPipeline) != VK_SUCCESS){
+    if(vkCreateGraphicsPipelines(aFinalCtorSet.mDevicePair.device, aFinalCtorSet.mPipelineCache, 1, &pipelineInfo, nullptr, &mGraphicsPipeline) != VK_SUCCESS){
         throw std::runtime_error("Failed to create graphics pipeline!");
     }
 }
@@ -230,7 +230,7 @@ void VulkanBasicRasterPipelineBuilder::prepareRenderPass(GraphicsPipelineConstru
         aCtorSetInOut.mRenderpassCtorSet.mDepthAttachment.format = aCtorSetInOut.mDepthBundle.format;
         aCtorSetInOut.mRenderpassCtorSet.mDepthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
         aCtorSetInOut.mRenderpassCtorSet.mDepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        aCtorSetInOut.mRenderpassCtorSet.mDepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        aCtorSetInOut.mRenderpassCtorSet.mDepthAttachment.storeOp = aCtorSetInOut.mDepthBundle.transient ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
         aCtorSetInOut.mRenderpassCtorSet.mDepthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         aCtorSetInOut.mRenderpassCtorSet.mDepthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         aCtorSetInOut.mRenderpassCtorSet.mDepthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -271,7 +271,7 @@ void VulkanBasicRasterPipelineBuilder::prepareRenderPass(GraphicsPipelineConstru
     }
 }
 
-VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(const GraphicsPipelineConstructionSet& aCtorSet){
+VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(const GraphicsPipelineConstructionSet& aCtorSet, bool aTransient){
     VulkanDepthBundle bundle;
     if(aCtorSet.mSwapchainBundle == nullptr){
         std::cerr << "Error: 'autoCreateDepthBuffer()' requires that a swapchain bundle is attached to the construction set." << std::endl;
@@ -279,11 +279,13 @@ VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(const
     }
 
     bundle.format = vkutils::select_depth_format(aCtorSet.mDevicePair.physicalDevice);
+    bundle.transient = aTransient;
 
     VkImageCreateInfo imageInfo = {};
     {
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if(aTransient) imageInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
         imageInfo.extent = VkExtent3D{aCtorSet.mSwapchainBundle->extent.width, aCtorSet.mSwapchainBundle->extent.height, 1};
         imageInfo.format = bundle.format;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -302,6 +304,16 @@ VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(const
     }
 
     VmaAllocator allocator = VmaHost::getAllocator({aCtorSet.mDevicePair.device, aCtorSet.mDevicePair.physicalDevice});
+
+    // Lazily allocated memory is mostly found on tiled GPUs. Elsewhere the transient image stays in device local memory.
+    if(aTransient){
+        VmaAllocationCreateInfo lazyInfo = allocInfo;
+        lazyInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        uint32_t memoryType = 0;
+        if(vmaFindMemoryTypeIndexForImageInfo(allocator, &imageInfo, &lazyInfo, &memoryType) == VK_SUCCESS){
+            allocInfo = lazyInfo;
+        }
+    }
     if(vmaCreateImage(allocator, &imageInfo, &allocInfo, &bundle.depthImage, &bundle.mAllocation, &bundle.mAllocInfo) != VK_SUCCESS){
         throw std::runtime_error("Failed to create depth image!");
     }
@@ -324,8 +336,8 @@ VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(const
     return(bundle);
 }
 
-VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer() const{
-    return(autoCreateDepthBuffer(_mConstructionSet));
+VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(bool aTransient) const{
+    return(autoCreateDepthBuffer(_mConstructionSet, aTransient));
 }
 
 } // end namespace vkutils
\ No newline at end of file
@@ -16,6 +16,10 @@ struct VulkanDepthBundle{
     VmaAllocation mAllocation = VK_NULL_HANDLE;
     VmaAllocationInfo mAllocInfo = {};
     VkFormat format;
+
+    /// Created with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT. Its contents are discarded after each render pass,
+    /// and it lives in lazily allocated memory when the device has any.
+    bool transient = false;
 };
 
 class VulkanRenderPipeline
@@ -112,6 +116,9 @@ class GraphicsPipelineConstructionSet
     VkPipelineDepthStencilStateCreateInfo mDepthStencilInfo;
     std::vector<VkDynamicState> mDynamicStates;
 
+    // Optional cache used when creating the pipeline, e.g. PipelineCache::handle()
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+
  protected:
     friend class VulkanBasicRasterPipelineBuilder;
     GraphicsPipelineConstructionSet(){}
@@ -140,11 +147,13 @@ class VulkanBasicRasterPipelineBuilder : public VulkanRenderPipeline
 
     /// Automatically select an appropriate depth buffer configuration based on aCtorSet and return the created depth buffer
     /// NOTE: An swapchain bundle must be bound to the construction set. 
-    static VulkanDepthBundle autoCreateDepthBuffer(const GraphicsPipelineConstructionSet& aCtorSet);
+    /// \param aTransient Create a transient depth buffer for passes that never read depth afterwards. prepareRenderPass()
+    /// then discards depth at the end of the pass, so tiled GPUs need not write it back or even back it with memory.
+    static VulkanDepthBundle autoCreateDepthBuffer(const GraphicsPipelineConstructionSet& aCtorSet, bool aTransient = false);
     
     /// Automatically select an appropriate depth buffer configuration based on the internal construction set and return the created depth buffer
     /// NOTE: An swapchain bundle must be bound to the construction set. 
-    VulkanDepthBundle autoCreateDepthBuffer() const;
+    VulkanDepthBundle autoCreateDepthBuffer(bool aTransient = false) const;
 
     /// Submit aFinalCtorSet as the construction set for this pipeline. The pipeline
     /// is then created fresh using the given construction set. The success of this